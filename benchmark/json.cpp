@@ -0,0 +1,100 @@
+#include <nodepp/nodepp.h>
+#include <express/http.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+using namespace nodepp;
+
+/*────────────────────────────────────────────────────────────────────────────*/
+
+/* the same list of records is serialized twice: once by building the
+   object_t tree a handler would hand to sendJSON and stringifying it, and
+   once through the compile-time fields() description; only the
+   serialization is timed and only the allocations made inside it are counted */
+
+#define BENCH_OPS 2048
+
+static ulong bench_alloc = 0; static bool bench_track = false;
+
+void* operator new( size_t size ){
+      if( bench_track ){ bench_alloc++; } void* ptr = malloc( size );
+      if( ptr == nullptr ){ throw std::bad_alloc(); } return ptr;
+}
+
+void operator delete( void* ptr ) noexcept { free( ptr ); }
+
+void operator delete( void* ptr, size_t ) noexcept { free( ptr ); }
+
+/*────────────────────────────────────────────────────────────────────────────*/
+
+struct record_t {
+    ulong id; string_t name; double score; bool active; array_t<string_t> tags;
+
+    template< class T > void fields( T& json ) const {
+        json( "id", id )( "name", name )( "score", score )( "active", active )( "tags", tags );
+    }
+};
+
+string_t dynamic( const array_t<record_t>& list ) {
+    array_t<object_t> out; for( ulong x=0; x<list.size(); x++ ){ auto& item = list[x];
+        array_t<object_t> tags; for( ulong y=0; y<item.tags.size(); y++ ){ tags.push( item.tags[y] ); }
+        out.push( object_t({
+            { "id"    , item.id     },
+            { "name"  , item.name   },
+            { "score" , item.score  },
+            { "active", item.active },
+            { "tags"  , tags        }
+        }));
+    }   return json::stringify( object_t( out ) );
+}
+
+string_t typed( const array_t<record_t>& list ) {
+    _express_::writer_t out; _express_::encode( out, list ); return out.get();
+}
+
+/*────────────────────────────────────────────────────────────────────────────*/
+
+void measure( string_t mode, ulong size ) {
+
+    array_t<record_t> list; for( ulong x=0; x<size; x++ ){
+        list.push( record_t({ x, string::format( "user \"%lu\"", x ), x * 0.5, x%2==0,
+                              array_t<string_t>({ "alpha", "beta", "gamma" }) }) );
+    }
+
+    ulong ops = max( BENCH_OPS / size, 1UL ); double time = 0;
+    ulong allocs = 0; ulong bytes = 0;
+
+    for( ulong x=0; x<=ops; x++ ){
+
+         auto a = std::chrono::steady_clock::now(); bench_alloc=0; bench_track=true;
+         string_t out = mode == "object_t" ? dynamic( list ) : typed( list );
+         bench_track=false; auto b = std::chrono::steady_clock::now();
+
+         if( x == 0 ){ continue; } /* warm up */
+         time  += std::chrono::duration<double,std::nano>( b - a ).count();
+         allocs+= bench_alloc; bytes = out.size();
+
+    }
+
+    printf( "{\"bench\":\"json\",\"mode\":\"%s\",\"records\":%lu,\"bytes\":%lu,\"ops\":%lu,\"ns_op\":%.1f,\"allocs_op\":%.2f}\n",
+             mode.get(), size, bytes, ops, time/ops, (double)allocs/ops );
+    fflush( stdout );
+
+}
+
+/*────────────────────────────────────────────────────────────────────────────*/
+
+void onMain() {
+
+    array_t<string_t> mode ({ "object_t", "typed" });
+    array_t<ulong>    size ({ 1, 16, 256, 4096 });
+
+    for( ulong x=0; x<size.size(); x++ ){
+    for( ulong y=0; y<mode.size(); y++ ){
+         measure( mode[y], size[x] );
+    }}
+
+}
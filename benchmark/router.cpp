@@ -0,0 +1,122 @@
+#include <nodepp/nodepp.h>
+#include <express/http.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace nodepp;
+
+/*────────────────────────────────────────────────────────────────────────────*/
+
+/* requests are built on top of a dup() of /dev/null, so handlers can be
+   dispatched through express_tcp_t::run without any socket; only the run()
+   call itself is timed and only the allocations made inside it are counted */
+
+#define BENCH_BATCH 256
+#define BENCH_OPS   20480
+
+static ulong bench_alloc = 0; static bool bench_track = false;
+
+void* operator new( size_t size ){
+      if( bench_track ){ bench_alloc++; } void* ptr = malloc( size );
+      if( ptr == nullptr ){ throw std::bad_alloc(); } return ptr;
+}
+
+void operator delete( void* ptr ) noexcept { free( ptr ); }
+
+void operator delete( void* ptr, size_t ) noexcept { free( ptr ); }
+
+/*────────────────────────────────────────────────────────────────────────────*/
+
+static ulong bench_served = 0;
+
+express_tcp_t build( string_t kind, ulong size, string_t& target ) {
+
+    auto app = express::http::add(); auto last = size - 1;
+    auto cb  = []( express_http_t cli ){ bench_served++; cli.done(); };
+
+    app.USE([]( express_http_t cli, function_t<void> next ){ next(); });
+
+    if( kind == "static" ){
+        for( ulong x=0; x<size; x++ ){ app.GET( string::format("/static/route%lu",x), cb ); }
+        target = string::format( "/static/route%lu", last );
+    }
+
+    elif( kind == "param" ){
+        for( ulong x=0; x<size; x++ ){ app.GET( string::format("/param/route%lu/:id",x), cb ); }
+        target = string::format( "/param/route%lu/42", last );
+    }
+
+    elif( kind == "glob" ){
+        for( ulong x=0; x<size; x++ ){ app.GET( string::format("/glob/route%lu/*",x), cb ); }
+        target = string::format( "/glob/route%lu/a/b", last );
+    }
+
+    elif( kind == "nested" ){
+        auto api = express::http::add(); ulong width = size / 10;
+        for( ulong y=0; y<10; y++ ){ auto ver = express::http::add();
+        for( ulong x=0; x<width; x++ ){ ver.GET( string::format("/route%lu",x), cb ); }
+             api.USE( string::format("/v%lu",y), ver );
+        }    app.USE( "/api", api );
+        target = string::format( "/api/v9/route%lu", width-1 );
+    }
+
+    return app;
+}
+
+/*────────────────────────────────────────────────────────────────────────────*/
+
+void measure( string_t kind, ulong size, string_t mode ) {
+
+    string_t target; auto app = build( kind, size, target );
+    if( regex::test( mode, "cache" ) ){ app.set_cache( 1024 ); }
+    if( regex::test( mode, "compiled" ) ){ app.compile(); }
+
+    int fd = open( "/dev/null", O_RDWR ); double time = 0;
+    ulong allocs = 0; ulong ops = 0; bench_served = 0;
+
+    for( ulong round=0; round<=BENCH_OPS/BENCH_BATCH; round++ ){
+
+         array_t<express_http_t> batch;
+         for( ulong x=0; x<BENCH_BATCH; x++ ){
+              http_t raw( dup(fd) ); raw.method = "GET"; raw.path = target;
+              batch.push( express_http_t( raw ) );
+         }
+
+         auto a = std::chrono::steady_clock::now(); bench_alloc=0; bench_track=true;
+         for( ulong x=0; x<BENCH_BATCH; x++ ){ app.run( batch[x] ); }
+         bench_track=false; auto b = std::chrono::steady_clock::now();
+
+         if( round == 0 ){ continue; } /* warm up */
+         time  += std::chrono::duration<double,std::nano>( b - a ).count();
+         allocs+= bench_alloc; ops += BENCH_BATCH;
+
+    }   close( fd );
+
+    printf( "{\"bench\":\"router\",\"kind\":\"%s\",\"routes\":%lu,\"mode\":\"%s\",\"ops\":%lu,\"ns_op\":%.1f,\"allocs_op\":%.2f,\"ok\":%s}\n",
+             kind.get(), size, mode.get(), ops, time/ops, (double)allocs/ops,
+             bench_served == ops + BENCH_BATCH ? "true" : "false" );
+    fflush( stdout );
+
+}
+
+/*────────────────────────────────────────────────────────────────────────────*/
+
+void onMain() {
+
+    array_t<string_t> kind ({ "static", "param", "glob", "nested" });
+    array_t<string_t> mode ({ "tree", "cache", "compiled", "compiled+cache" });
+    array_t<ulong>    size ({ 10, 100, 1000, 10000 });
+
+    for( ulong x=0; x<kind.size(); x++ ){
+    for( ulong y=0; y<size.size(); y++ ){
+    for( ulong z=0; z<mode.size(); z++ ){
+         measure( kind[x], size[y], mode[z] );
+    }}}
+
+}
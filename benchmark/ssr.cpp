@@ -0,0 +1,85 @@
+#include <nodepp/nodepp.h>
+#include <express/http.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace nodepp;
+
+/*────────────────────────────────────────────────────────────────────────────*/
+
+/* a template of the requested size is built from plain html with one
+   <° include °> every kilobyte; the regex path below is the parse() the
+   generator used before the scanner, both must agree on every segment */
+
+#define BENCH_BYTES 67108864
+
+ptr_t<_express_::template_t> parse_regex( string_t raw ) {
+    ptr_t<_express_::template_t> out = new _express_::template_t(); ulong pos = 0;
+    auto match = regex::search_all( raw, "<°[^°]+°>" );
+    for( ulong x=0; x<match.size(); x++ ){ auto reg = match[x];
+         auto tag = raw.slice( reg[0], reg[1] );
+         out->text.push( raw.slice( pos, reg[0] ) );
+         out->dir .push( regex::match( tag, "[^<°> \n\t]+" ) ); pos = reg[1];
+    }    out->text.push( raw.slice( pos ) ); return out;
+}
+
+string_t build( ulong size ) {
+    string_t out; ulong x = 0; while( out.size() < size ){
+         out += "<div class=\"row\"><p>lorem ipsum dolor sit amet, consectetur adipiscing elit</p></div>\n";
+         if( ++x % 12 == 0 ){ out += string::format( "<° route:/part/%lu max-age=60 °>\n", x ); }
+    }    return out.slice( 0, size );
+}
+
+bool same( ptr_t<_express_::template_t> a, ptr_t<_express_::template_t> b ) {
+    if( a->text.size() != b->text.size() || a->dir.size() != b->dir.size() ){ return false; }
+    for( ulong x=0; x<a->dir.size();  x++ ){ if( a->dir[x]  != b->dir[x]  ){ return false; } }
+    for( ulong x=0; x<a->text.size(); x++ ){ if( a->text[x] != b->text[x] ){ return false; } }
+    return true;
+}
+
+/*────────────────────────────────────────────────────────────────────────────*/
+
+void measure( string_t mode, ulong size ) {
+
+    auto raw = build( size ); ulong ops = max( (ulong) 4, (ulong) BENCH_BYTES / size );
+    bool ok  = same( _express_::parse( raw ), parse_regex( raw ) );
+    double time = 0; ulong tags = 0;
+
+    for( ulong x=0; x<ops; x++ ){
+         auto a = std::chrono::steady_clock::now();
+
+         if( mode == "scanner" ){
+             _express_::mark_t tag; ulong pos = 0; tags = 0;
+             while( _express_::scan( raw.get(), raw.size(), pos, tag ) ){ pos = tag.end; tags++; }
+         }
+
+         elif( mode == "parse" ){ tags = _express_::parse( raw )->dir.size(); }
+
+         else { tags = parse_regex( raw )->dir.size(); }
+
+         auto b = std::chrono::steady_clock::now();
+         time += std::chrono::duration<double,std::nano>( b - a ).count();
+    }
+
+    printf( "{\"bench\":\"ssr\",\"mode\":\"%s\",\"bytes\":%lu,\"tags\":%lu,\"ops\":%lu,\"ns_op\":%.1f,\"mb_s\":%.1f,\"ok\":%s}\n",
+             mode.get(), size, tags, ops, time/ops, ( size*ops/1048576.0 ) / ( time/1e9 ),
+             ok ? "true" : "false" );
+    fflush( stdout );
+
+}
+
+/*────────────────────────────────────────────────────────────────────────────*/
+
+void onMain() {
+
+    array_t<string_t> mode ({ "regex", "parse", "scanner" });
+    array_t<ulong>    size ({ 10240, 102400, 1048576 });
+
+    for( ulong x=0; x<size.size(); x++ ){
+    for( ulong y=0; y<mode.size(); y++ ){
+         measure( mode[y], size[x] );
+    }}
+
+}
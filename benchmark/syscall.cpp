@@ -0,0 +1,96 @@
+#include <nodepp/nodepp.h>
+#include <express/http.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+#include <dlfcn.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#include <sys/socket.h>
+
+using namespace nodepp;
+
+/*────────────────────────────────────────────────────────────────────────────*/
+
+/* write, writev, send and sendto are interposed so every call issued while
+   a response is produced can be counted; each response is written to one
+   end of a socketpair and the other end is drained outside the timing */
+
+#define BENCH_OPS 4096
+
+static ulong bench_calls = 0; static bool bench_track = false;
+
+template< class T > T bench_next( const char* name ){ return (T) dlsym( RTLD_NEXT, name ); }
+
+extern "C" ssize_t write( int fd, const void* buf, size_t len ){
+      static auto real = bench_next<ssize_t(*)(int,const void*,size_t)>( "write" );
+      if( bench_track ){ bench_calls++; } return real( fd, buf, len );
+}
+
+extern "C" ssize_t writev( int fd, const struct iovec* io, int len ){
+      static auto real = bench_next<ssize_t(*)(int,const struct iovec*,int)>( "writev" );
+      if( bench_track ){ bench_calls++; } return real( fd, io, len );
+}
+
+extern "C" ssize_t send( int fd, const void* buf, size_t len, int flag ){
+      static auto real = bench_next<ssize_t(*)(int,const void*,size_t,int)>( "send" );
+      if( bench_track ){ bench_calls++; } return real( fd, buf, len, flag );
+}
+
+extern "C" ssize_t sendto( int fd, const void* buf, size_t len, int flag, const struct sockaddr* addr, socklen_t alen ){
+      static auto real = bench_next<ssize_t(*)(int,const void*,size_t,int,const struct sockaddr*,socklen_t)>( "sendto" );
+      if( bench_track ){ bench_calls++; } return real( fd, buf, len, flag, addr, alen );
+}
+
+/*────────────────────────────────────────────────────────────────────────────*/
+
+void drain( int fd ) {
+     char buffer[ 65536 ];
+     while( recv( fd, buffer, sizeof(buffer), MSG_DONTWAIT ) > 0 ){}
+}
+
+void measure( string_t mode, ulong size ) {
+
+    string_t body ( size, 'x' ); double time = 0;
+    ulong calls = 0; ulong ops = 0;
+
+    for( ulong x=0; x<BENCH_OPS; x++ ){ int sv[2];
+         if( socketpair( AF_UNIX, SOCK_STREAM, 0, sv ) != 0 ){ break; }
+
+         http_t raw( sv[0] ); raw.method = "GET"; raw.path = "/"; do {
+         express_http_t cli( raw ); cli.header( "Content-Type", "application/json" );
+
+         auto a = std::chrono::steady_clock::now(); bench_calls=0; bench_track=true;
+         if( mode == "split" ){
+             cli.header( "Content-Length", string::to_string( body.size() ) );
+             cli.send(); cli.write( body ); cli.finish();
+         } else { cli.send( body ); }
+         bench_track=false; auto b = std::chrono::steady_clock::now();
+
+         time += std::chrono::duration<double,std::nano>( b - a ).count();
+         calls+= bench_calls; ops++; } while(0);
+
+         drain( sv[1] ); close( sv[1] );
+    }
+
+    printf( "{\"bench\":\"syscall\",\"mode\":\"%s\",\"body\":%lu,\"ops\":%lu,\"ns_op\":%.1f,\"syscalls_op\":%.2f}\n",
+             mode.get(), size, ops, time/ops, (double)calls/ops );
+    fflush( stdout );
+
+}
+
+/*────────────────────────────────────────────────────────────────────────────*/
+
+void onMain() {
+
+    array_t<string_t> mode ({ "split", "coalesced" });
+    array_t<ulong>    size ({ 64, 1024, 16384, 131072 });
+
+    for( ulong x=0; x<size.size(); x++ ){
+    for( ulong y=0; y<mode.size(); y++ ){
+         measure( mode[y], size[x] );
+    }}
+
+}
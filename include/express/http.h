@@ -24,6 +24,7 @@
 #include <nodepp/optional.h>
 #include <nodepp/cookie.h>
 #include <nodepp/stream.h>
+#include <nodepp/worker.h>
 #include <nodepp/https.h>
 #include <nodepp/http.h>
 #include <nodepp/path.h>
@@ -34,21 +35,1700 @@
 
 /*────────────────────────────────────────────────────────────────────────────*/
 
+#ifndef NODEPP_EXPRESS_ROUTER
+#define NODEPP_EXPRESS_ROUTER
+namespace nodepp { namespace _express_ {
+
+     enum SEGMENT { SEGMENT_TEXT, SEGMENT_PARAM, SEGMENT_GLOB };
+
+     struct segment_t { string_t data; ulong size=0, hash=0; uchar type=SEGMENT_TEXT; };
+
+     struct token_t   { ulong pos=0, size=0, hash=0; };
+
+     enum METHOD {
+          METHOD_ANY , METHOD_GET    , METHOD_POST , METHOD_PUT  , METHOD_DELETE ,
+          METHOD_HEAD, METHOD_OPTIONS, METHOD_PATCH, METHOD_TRACE, METHOD_CONNECT,
+          METHOD_EXTEND, METHOD_SIZE
+     };
+
+     struct request_t { array_t<token_t> list; uchar method=METHOD_ANY; };
+
+     uchar method( string_t name ) noexcept {
+          if( name.empty() ){ return METHOD_ANY; } switch( name[0] ){
+              case 'G': if( name=="GET"     ){ return METHOD_GET;     } break;
+              case 'P': if( name=="POST"    ){ return METHOD_POST;    }
+                        if( name=="PUT"     ){ return METHOD_PUT;     }
+                        if( name=="PATCH"   ){ return METHOD_PATCH;   } break;
+              case 'D': if( name=="DELETE"  ){ return METHOD_DELETE;  } break;
+              case 'H': if( name=="HEAD"    ){ return METHOD_HEAD;    } break;
+              case 'O': if( name=="OPTIONS" ){ return METHOD_OPTIONS; } break;
+              case 'T': if( name=="TRACE"   ){ return METHOD_TRACE;   } break;
+              case 'C': if( name=="CONNECT" ){ return METHOD_CONNECT; } break;
+          }   return METHOD_EXTEND;
+     }
+
+     ulong hash( const char* bf, ulong sx ) noexcept {
+          ulong out = 2166136261UL; for( ulong x=0; x<sx; x++ ){ 
+                out = ( ( out ^ (uchar)bf[x] ) * 16777619UL ) & 0xFFFFFFFFUL;
+          }     return out;
+     }
+
+     array_t<segment_t> compile( string_t path ) noexcept {
+          array_t<segment_t> list; ulong pos = 0;
+          for( ulong x=0; x<=path.size(); x++ ){
+          if ( x==path.size() || path[x]=='/' ){ if( x>pos ){ segment_t seg;
+               seg.data = path.slice( pos, x );
+                 if( seg.data[0]==':' ){ seg.type=SEGMENT_PARAM; seg.data=seg.data.slice(1); }
+               elif( seg.data=="*"    ){ seg.type=SEGMENT_GLOB; }
+               seg.size = seg.data.size(); seg.hash = hash( seg.data.get(), seg.size );
+               list.push( seg ); } pos = x+1;
+          }}   return list;
+     }
+
+     array_t<token_t> tokenize( string_t path ) noexcept {
+          array_t<token_t> list; ulong pos = 0; const char* bf = path.get();
+          for( ulong x=0; x<=path.size(); x++ ){
+          if ( x==path.size() || bf[x]=='/' ){ if( x>pos ){ token_t tok;
+               tok.pos = pos; tok.size = x-pos; tok.hash = hash( bf+pos, x-pos );
+               list.push( tok ); } pos = x+1;
+          }}   return list;
+     }
+
+     bool equal( string_t& path, token_t& tok, segment_t& seg ) noexcept {
+          return tok.size==seg.size && tok.hash==seg.hash &&
+                 memcmp( path.get()+tok.pos, seg.data.get(), tok.size )==0;
+     }
+
+     void sort( array_t<ulong>& list ) noexcept {
+          for( ulong x=1; x<list.size(); x++ ){ ulong y=x, z=list[x];
+          while( y>0 && list[y-1]>z ){ list[y]=list[y-1]; y--; } list[y]=z; }
+     }
+
+     /*.........................................................................*/
+
+     struct chain_t { array_t<ulong> match, param; array_t<string_t> key, value; };
+
+     template< class T > class cache_t {
+     protected:
+
+          struct SLOT {
+               ptr_t<T> data;
+               string_t base, path;
+               uchar    method=0; bool bit=false;
+          };
+
+          array_t<SLOT> slot; ulong hand=0;
+
+          ulong index( uchar method, string_t& path ) const noexcept {
+                return ( hash( path.get(), path.size() ) * 31 + method ) % slot.size();
+          }
+
+     public: ulong hit=0, miss=0;
+
+          cache_t( ulong size ) noexcept { for( ulong x=0; x<size; x++ ){ slot.push( SLOT() ); } }
+
+          cache_t() noexcept {}
+
+          /* slots are looked up in a window of 4 starting at the key hash,
+             a hit sets the reference bit and a miss on insert evicts the
+             first slot of the window whose bit is already clear ( CLOCK ). */
+
+          ptr_t<T> get( uchar method, string_t& base, string_t& path ) noexcept {
+               if( slot.empty() ){ miss++; return ptr_t<T>(); } ulong idx = index( method, path );
+               for( ulong x=0; x<4 && x<slot.size(); x++ ){ auto& item = slot[ (idx+x) % slot.size() ];
+               if ( item.data.null() ){ continue; }
+               if ( item.method==method && item.path==path && item.base==base )
+                  { item.bit = true; hit++; return item.data; }
+               }    miss++; return ptr_t<T>();
+          }
+
+          ptr_t<T> set( uchar method, string_t& base, string_t& path, ptr_t<T> data ) noexcept {
+               if( slot.empty() ){ return ptr_t<T>(); } ulong idx = index( method, path );
+               ulong win = min( (ulong)4, slot.size() ), pos = idx + hand++ % win;
+
+               for( ulong x=0; x<win; x++ ){ auto& item = slot[ (idx+x) % slot.size() ];
+               if ( item.data.null() || !item.bit ){ pos = idx+x; break; } item.bit = false; }
+
+               auto& item = slot[ pos % slot.size() ]; auto prev = item.data;
+               item.data = data; item.bit = false;
+               item.method= method; item.base = base; item.path = path; return prev;
+          }
+
+          void clear() noexcept { for( ulong x=0; x<slot.size(); x++ ){ slot[x].data = ptr_t<T>(); } }
+
+          ptr_t<T> erase( uchar method, string_t& base, string_t& path ) noexcept {
+               if( slot.empty() ){ return ptr_t<T>(); } ulong idx = index( method, path );
+               for( ulong x=0; x<4 && x<slot.size(); x++ ){ auto& item = slot[ (idx+x) % slot.size() ];
+               if ( item.data.null() ){ continue; }
+               if ( item.method==method && item.path==path && item.base==base )
+                  { auto prev = item.data; item.data = ptr_t<T>(); return prev; }
+               }    return ptr_t<T>();
+          }
+
+     };
+
+}}
+#endif
+
+/*────────────────────────────────────────────────────────────────────────────*/
+
+#ifndef NODEPP_EXPRESS_COMPRESS
+#define NODEPP_EXPRESS_COMPRESS
+#include <zlib.h>
+#include <mutex>
+#include <condition_variable>
+#ifdef NODEPP_EXPRESS_BROTLI
+#include <brotli/encode.h>
+#endif
+namespace nodepp { namespace _express_ {
+
+     enum ENCODING { ENCODING_IDENTITY, ENCODING_DEFLATE, ENCODING_GZIP, ENCODING_BR, ENCODING_SIZE };
+
+     /* q-values are kept in thousandths, 0 means not acceptable */
+     struct accept_t { uint q[ENCODING_SIZE]; };
+
+     uchar encoding( string_t name ) noexcept {
+            if( regex::test( name, "^(x-)?gzip$", true ) ){ return ENCODING_GZIP;    }
+          elif( regex::test( name, "^deflate$",   true ) ){ return ENCODING_DEFLATE; }
+          elif( regex::test( name, "^br$",        true ) ){ return ENCODING_BR;      }
+          elif( regex::test( name, "^identity$",  true ) ){ return ENCODING_IDENTITY;}
+          return ENCODING_SIZE;
+     }
+
+     string_t coding( uchar type ) noexcept {
+          switch( type ){
+               case ENCODING_DEFLATE: return "deflate";
+               case ENCODING_GZIP:    return "gzip";
+               case ENCODING_BR:      return "br";
+               default:               return "identity";
+          }
+     }
+
+     uint quality( string_t value ) noexcept {
+          uint out=0, scale=1000; bool frac=false;
+          for( ulong x=0; x<value.size(); x++ ){
+               if( value[x]=='.' ){ frac=true; continue; }
+               if( !frac ){ out = ( value[x]-'0' ) * 1000; continue; }
+               scale /= 10; out += ( value[x]-'0' ) * scale;
+          }    return min( out, (uint)1000 );
+     }
+
+     accept_t accept( string_t header ) noexcept {
+          accept_t out; bool seen[ENCODING_SIZE]; uint star=0; bool wild=false;
+          for( ulong x=0; x<ENCODING_SIZE; x++ ){ out.q[x]=0; seen[x]=false; }
+
+          auto list = regex::match_all( header, "[^,]+" );
+          for( ulong x=0; x<list.size(); x++ ){
+               auto name = regex::match( list[x], "[^;\\s]+" ); uint q = 1000;
+               auto qval = regex::match( list[x], "q\\s*=\\s*[0-9.]+" );
+               if( !qval.empty() ){ q = quality( regex::match( qval, "[0-9.]+" ) ); }
+               if( name == "*" ){ star = q; wild = true; continue; }
+               auto type = encoding( name ); if( type == ENCODING_SIZE ){ continue; }
+               out.q[type] = q; seen[type] = true;
+          }
+
+          for( ulong x=0; x<ENCODING_SIZE; x++ ){ if( !seen[x] && wild ){ out.q[x] = star; } }
+          if( !seen[ENCODING_IDENTITY] && !wild ){ out.q[ENCODING_IDENTITY] = 1000; }
+          return out;
+     }
+
+     uchar best( accept_t& accept ) noexcept {
+          uchar out = ENCODING_IDENTITY; uint q = 0;
+     #ifdef NODEPP_EXPRESS_BROTLI
+          if( accept.q[ENCODING_BR]      > q ){ out = ENCODING_BR;      q = accept.q[ENCODING_BR];      }
+     #endif
+          if( accept.q[ENCODING_GZIP]    > q ){ out = ENCODING_GZIP;    q = accept.q[ENCODING_GZIP];    }
+          if( accept.q[ENCODING_DEFLATE] > q ){ out = ENCODING_DEFLATE; q = accept.q[ENCODING_DEFLATE]; }
+          return out;
+     }
+
+     /*.........................................................................*/
+
+     class zstream_t {
+     protected:
+
+          struct NODE {
+               z_stream z; uchar type=ENCODING_IDENTITY; bool ready=false;
+          #ifdef NODEPP_EXPRESS_BROTLI
+               BrotliEncoderState* br = nullptr;
+          #endif
+              ~NODE(){ if( ready ){ deflateEnd( &z ); }
+          #ifdef NODEPP_EXPRESS_BROTLI
+               if( br != nullptr ){ BrotliEncoderDestroyInstance( br ); }
+          #endif
+               }
+          };   ptr_t<NODE> obj;
+
+          string_t zpump( string_t& data, int flush ) const noexcept {
+               string_t out; char buffer[ CHUNK_KB(16) ];
+               obj->z.next_in = (Bytef*) data.get(); obj->z.avail_in = data.size();
+               do { obj->z.next_out = (Bytef*) buffer; obj->z.avail_out = sizeof(buffer);
+                    if( ::deflate( &obj->z, flush ) == Z_STREAM_ERROR ){ break; }
+                    out += string_t( buffer, sizeof(buffer) - obj->z.avail_out );
+               } while( obj->z.avail_out == 0 ); return out;
+          }
+
+     #ifdef NODEPP_EXPRESS_BROTLI
+          string_t bpump( string_t& data, BrotliEncoderOperation op ) const noexcept {
+               string_t out; char buffer[ CHUNK_KB(16) ];
+               size_t in = data.size(); const uint8_t* next = (const uint8_t*) data.get();
+               while( true ){ size_t avail = sizeof(buffer); uint8_t* pos = (uint8_t*) buffer;
+                    if( !BrotliEncoderCompressStream( obj->br, op, &in, &next, &avail, &pos, nullptr ) ){ break; }
+                    out += string_t( buffer, sizeof(buffer) - avail );
+                    if( in == 0 && !BrotliEncoderHasMoreOutput( obj->br ) &&
+                      ( op != BROTLI_OPERATION_FINISH || BrotliEncoderIsFinished( obj->br ) ) ){ break; }
+               }    return out;
+          }
+     #endif
+
+     public:
+
+          zstream_t( uchar type, int level ) noexcept : obj( new NODE() ) {
+               memset( &obj->z, 0, sizeof(z_stream) ); obj->type = type; level = min( max( level, 1 ), 9 );
+          #ifdef NODEPP_EXPRESS_BROTLI
+               if( type == ENCODING_BR ){ obj->br = BrotliEncoderCreateInstance( nullptr, nullptr, nullptr );
+                   BrotliEncoderSetParameter( obj->br, BROTLI_PARAM_QUALITY, level ); return;
+               }
+          #endif
+               int bits = type == ENCODING_GZIP ? MAX_WBITS + 16 : MAX_WBITS;
+               obj->ready = deflateInit2( &obj->z, level, Z_DEFLATED, bits, 8, Z_DEFAULT_STRATEGY ) == Z_OK;
+          }
+
+          zstream_t() noexcept : obj( new NODE() ) {}
+
+          string_t update( string_t data ) const noexcept {
+          #ifdef NODEPP_EXPRESS_BROTLI
+               if( obj->br != nullptr ){ return bpump( data, BROTLI_OPERATION_PROCESS ); }
+          #endif
+               if( !obj->ready ){ return data; } return zpump( data, Z_NO_FLUSH );
+          }
+
+          string_t end( string_t data=nullptr ) const noexcept {
+          #ifdef NODEPP_EXPRESS_BROTLI
+               if( obj->br != nullptr ){ return bpump( data, BROTLI_OPERATION_FINISH ); }
+          #endif
+               if( !obj->ready ){ return data; } return zpump( data, Z_FINISH );
+          }
+
+     };
+
+     /*.........................................................................*/
+
+     struct job_t { zstream_t z; string_t in, out; bool done=false; };
+
+     /* a fixed ring of jobs shared with the worker threads, push() fails
+        while `limit` jobs are still pending and the caller compresses
+        inline; idle workers sleep on `cond` and leave once stopped */
+
+     class offload_t {
+     protected:
+
+          struct NODE {
+               array_t<job_t*> ring; std::mutex mutex; std::condition_variable cond;
+               ulong head=0, tail=0, pending=0; bool stop=false;
+          };   ptr_t<NODE> obj;
+
+     public:
+
+          offload_t( ulong threads, ulong limit ) noexcept : obj( new NODE() ) {
+               do { obj->ring.push( nullptr ); } while( obj->ring.size() < limit );
+               ulong x=0; do { auto self = obj; worker::add([=](){
+                    std::unique_lock<std::mutex> lock( self->mutex );
+                    self->cond.wait( lock, [&](){ return self->stop || self->head < self->tail; } );
+                    if( self->head == self->tail ){ return -1; }
+                    auto job = self->ring[ self->head++ % self->ring.size() ]; lock.unlock();
+
+                    auto out = job->z.end( job->in ); lock.lock();
+                    job->out = out; job->done = true; self->pending--; return 1;
+               }); } while( ++x < threads );
+          }
+
+          offload_t() noexcept : obj( new NODE() ) {}
+
+         ~offload_t() noexcept { stop(); }
+
+          /* queued jobs are still finished, then every worker returns */
+
+          void stop() const noexcept {
+               { std::lock_guard<std::mutex> lock( obj->mutex ); obj->stop = true; }
+               obj->cond.notify_all();
+          }
+
+          bool push( job_t* job ) const noexcept {
+               { std::lock_guard<std::mutex> lock( obj->mutex );
+                 if( obj->stop || obj->pending >= obj->ring.size() ){ return false; }
+                 obj->ring[ obj->tail++ % obj->ring.size() ] = job; obj->pending++;
+               }    obj->cond.notify_one(); return true;
+          }
+
+          bool done( job_t* job ) const noexcept {
+               std::lock_guard<std::mutex> lock( obj->mutex ); return job->done;
+          }
+
+          ulong depth() const noexcept {
+               std::lock_guard<std::mutex> lock( obj->mutex ); return obj->pending;
+          }
+
+     };
+
+     GENERATOR( offload ) {
+     public:
+
+          template< class T, class V >
+          coEmit( T& pool, ptr_t<job_t>& job, V& cb ){
+          gnStart
+               while( !pool->done( job.get() ) ){ coNext; } cb( job->out );
+          gnStop
+          }
+
+     };
+
+     /*.........................................................................*/
+
+     struct compress_t {
+          string_t mime = "^text/|json|javascript|xml|svg|wasm";
+          ulong    min  = 1024; int level = 6;
+          ptr_t<offload_t> pool; ulong offload = CHUNK_KB(64);
+     };
+
+}}
+#endif
+
+/*────────────────────────────────────────────────────────────────────────────*/
+
+#ifndef NODEPP_EXPRESS_JSON
+#define NODEPP_EXPRESS_JSON
+#include <type_traits>
+#include <cstdlib>
+namespace nodepp { namespace _express_ {
+
+     /* walks an object_t depth first and hands the serialized text out
+        in pieces of about `limit` bytes; containers are opened member by
+        member, anything else goes through json::stringify */
+
+     class jsonify_t {
+     protected:
+
+          struct FRAME {
+               object_t data; array_t<string_t> keys;
+               array_t<object_t> list; ulong pos=0; bool array=false;
+          };
+
+          array_t<FRAME> stack; object_t root; bool ready=false;
+
+          void open( object_t data, string_t& out ) noexcept { FRAME item; item.data = data;
+                 if( data.is<array_t<object_t>>() ){ item.array = true; item.list = data.as<array_t<object_t>>(); out += "["; }
+               elif( data.is<map_t<string_t,object_t>>() ){ item.keys = data.keys(); out += "{"; }
+               else { out += json::stringify( data ); return; } stack.push( item );
+          }
+
+          void step( string_t& out ) noexcept { auto& item = stack[ stack.last() ];
+               ulong size = item.array ? item.list.size() : item.keys.size();
+               if( item.pos >= size ){ out += item.array ? "]" : "}"; stack.pop(); return; }
+               if( item.pos > 0 ){ out += ","; } ulong pos = item.pos++;
+               if( item.array ){ open( item.list[pos], out ); return; }
+               out += json::stringify( object_t( item.keys[pos] ) ) + ":";
+               open( item.data[ item.keys[pos] ], out );
+          }
+
+     public:
+
+          jsonify_t( object_t data ) noexcept : root( data ) {}
+
+          bool next( string_t& out, ulong limit ) noexcept {
+               if( !ready ){ ready = true; open( root, out ); }
+               while( !stack.empty() && out.size() < limit ){ step( out ); }
+               return !stack.empty();
+          }
+
+     };
+
+     /*.........................................................................*/
+
+     /* compile-time serialization: a struct lists its members once with
+        template< class T > void fields( T& json ) const { json( "id", id )( "name", name ); }
+        and encode() writes it straight into one growing buffer */
+
+     class writer_t {
+     protected:
+
+          ptr_t<char> data; ulong size=0, cap=0;
+
+          void grow( ulong len ) noexcept { if( size+len <= cap ){ return; }
+               cap = max( cap*2, size+len+64 ); ptr_t<char> next ( cap );
+               if( size > 0 ){ memcpy( next.get(), data.get(), size ); } data = next;
+          }
+
+     public:
+
+          writer_t& push( const char* str, ulong len ) noexcept {
+               grow( len ); memcpy( data.get()+size, str, len ); size += len; return (*this);
+          }
+
+          writer_t& push( char value ) noexcept { return push( &value, 1 ); }
+
+          string_t get() const noexcept { return size==0 ? string_t() : string_t( data.get(), size ); }
+
+     };
+
+     void encode( writer_t& out, bool value ) noexcept {
+          if( value ){ out.push( "true", 4 ); } else { out.push( "false", 5 ); }
+     }
+
+     void encode( writer_t& out, const char* value ) noexcept {
+          out.push( '"' ); ulong pos = 0, x = 0; char bf[8];
+          for( ; value[x] != '\0'; x++ ){ uchar c = value[x];
+               if( c != '"' && c != '\\' && c >= 0x20 ){ continue; }
+               out.push( value+pos, x-pos ); pos = x+1;
+                 if( c == '"'  ){ out.push( "\\\"", 2 ); }
+               elif( c == '\\' ){ out.push( "\\\\", 2 ); }
+               elif( c == '\n' ){ out.push( "\\n",  2 ); }
+               elif( c == '\r' ){ out.push( "\\r",  2 ); }
+               elif( c == '\t' ){ out.push( "\\t",  2 ); }
+               else { out.push( bf, snprintf( bf, sizeof(bf), "\\u%04x", c ) ); }
+          }    out.push( value+pos, x-pos ).push( '"' );
+     }
+
+     void encode( writer_t& out, const string_t& value ) noexcept {
+          if( value.empty() ){ out.push( "\"\"", 2 ); return; } encode( out, value.get() );
+     }
+
+     void encode( writer_t& out, const object_t& value ) noexcept {
+          auto data = json::stringify( value ); out.push( data.get(), data.size() );
+     }
+
+     template< class T >
+     void encode( writer_t& out, const array_t<T>& value ) noexcept { out.push( '[' );
+          for( ulong x=0; x<value.size(); x++ ){ if( x>0 ){ out.push( ',' ); } encode( out, value[x] ); }
+          out.push( ']' );
+     }
+
+     template< class T >
+     void encode( writer_t& out, const ptr_t<T>& value ) noexcept {
+          if( value.null() ){ out.push( "null", 4 ); return; } encode( out, *value );
+     }
+
+     class fields_t {
+     protected:
+
+          writer_t& out; bool first=true;
+
+     public:
+
+          fields_t( writer_t& out ) noexcept : out( out ) {}
+
+          template< class V >
+          fields_t& operator()( const char* key, const V& value ) noexcept {
+               if( !first ){ out.push( ',' ); } first = false;
+               encode( out, key ); out.push( ':' ); encode( out, value ); return (*this);
+          }
+
+     };
+
+     template< class T >
+     void encode( writer_t& out, const T& value, std::true_type ) noexcept { char bf[32];
+          if( std::is_floating_point<T>::value ){ double num = value;
+              if( num != num || num-num != 0 ){ out.push( "null", 4 ); return; } int len = 0;
+              for( int digits=15; digits<=17; digits++ ){ /* shortest text that reads back the same */
+                   len = snprintf( bf, sizeof(bf), "%.*g", digits, num ); if( strtod( bf, nullptr ) == num ){ break; }
+              }    out.push( bf, len );
+          } elif( std::is_signed<T>::value ){
+              out.push( bf, snprintf( bf, sizeof(bf), "%lld", (long long) value ) );
+          } else {
+              out.push( bf, snprintf( bf, sizeof(bf), "%llu", (unsigned long long) value ) );
+          }
+     }
+
+     template< class T >
+     void encode( writer_t& out, const T& value, std::false_type ) noexcept {
+          fields_t list ( out ); out.push( '{' ); value.fields( list ); out.push( '}' );
+     }
+
+     template< class T >
+     void encode( writer_t& out, const T& value ) noexcept {
+          encode( out, value, typename std::is_arithmetic<T>::type() );
+     }
+
+     /* records are structs with fields(), or array_t / ptr_t of them; any
+        other sendJSON() argument keeps converting to object_t */
+
+     template< class T > std::true_type  probe( decltype( &T::template fields<fields_t> ) ) noexcept;
+     template< class T > std::false_type probe( ... ) noexcept;
+
+     template< class T > struct is_record : decltype( probe<T>( nullptr ) ) {};
+     template< class T > struct is_record<array_t<T>> : is_record<T> {};
+     template< class T > struct is_record<ptr_t<T>>   : is_record<T> {};
+
+}}
+#endif
+
+/*────────────────────────────────────────────────────────────────────────────*/
+
+#ifndef NODEPP_EXPRESS_STATIC
+#define NODEPP_EXPRESS_STATIC
+#include <sys/stat.h>
+namespace nodepp { namespace _express_ {
+
+     string_t sidecar( accept_t& accept, string_t dir ) noexcept {
+          if( accept.q[ENCODING_BR] && accept.q[ENCODING_BR] >= accept.q[ENCODING_GZIP]
+                                    && fs::exists_file( dir+".br" ) ){ return ".br"; }
+          if( accept.q[ENCODING_GZIP] && fs::exists_file( dir+".gz" ) ){ return ".gz"; }
+          return nullptr;
+     }
+
+     void precompress( string_t base ) noexcept {
+          auto list = fs::read_folder( base );
+          for( ulong x=0; x<list.size(); x++ ){ 
+          if ( list[x]=="." || list[x]==".." ){ continue; } auto dir = path::join( base, list[x] );
+          if ( fs::exists_folder( dir ) ){ precompress( dir ); continue; }
+          if ( regex::test( dir, "\\.(gz|br)$" ) || fs::exists_file( dir+".gz" ) ){ continue; }
+          if ( !regex::test( path::mimetype(dir), "text|javascript|json|xml|svg", true ) ){ continue; }
+               auto file = fs::readable( dir ); auto data = stream::await( file );
+               file_t out ( dir+".gz", "w" ); out.write( zlib::gzip::get( data ) ); out.close();
+          #ifdef NODEPP_EXPRESS_BROTLI
+               file_t alt ( dir+".br", "w" ); alt.write( zstream_t( ENCODING_BR, 9 ).end( data ) ); alt.close();
+          #endif
+          }
+     }
+
+     /*.........................................................................*/
+
+     struct asset_t {
+          string_t dir, type, etag, date, data, gzip, br;
+          ulong    size=0, mtime=0; uint status=200; bool memory=false;
+     };
+
+     struct assets_t { cache_t<asset_t> cache; ulong used=0, limit=0, max=0; };
+
+     bool stat_file( string_t dir, ulong& size, ulong& mtime ) noexcept {
+          struct stat st; if( ::stat( dir.get(), &st )!=0 || !S_ISREG(st.st_mode) ){ return false; }
+          size = st.st_size; mtime = st.st_mtime; return true;
+     }
+
+     string_t http_date( ulong time ) noexcept {
+          char bf[64]; time_t raw = time; struct tm* gmt = gmtime( &raw );
+          if( gmt == nullptr ){ return nullptr; }
+          strftime( bf, sizeof(bf), "%a, %d %b %Y %H:%M:%S GMT", gmt ); return string_t( bf );
+     }
+
+     /* IMF-fixdate back to seconds since the epoch, 0 when it does not parse */
+
+     ulong parse_date( string_t date ) noexcept {
+          int d=0, y=0, h=0, m=0, s=0; char mon[4] = {0}; const char* list = "JanFebMarAprMayJunJulAugSepOctNovDec";
+          if( date.size() < 29 || sscanf( date.get()+5, "%d %3s %d %d:%d:%d", &d, mon, &y, &h, &m, &s ) != 6 ){ return 0; }
+          auto pos = strstr( list, mon ); if( pos == nullptr || strlen( mon ) != 3 || ( pos-list ) % 3 ){ return 0; }
+          long mo = ( pos-list ) / 3 + 1; long yy = y - ( mo <= 2 ); long era = ( yy >= 0 ? yy : yy-399 ) / 400;
+          long yoe = yy - era*400, doy = ( 153*( mo + ( mo > 2 ? -3 : 9 ) ) + 2 )/5 + d-1;
+          long days = era*146097 + yoe*365 + yoe/4 - yoe/100 + doy - 719468;
+          return days < 0 ? 0 : days*86400 + h*3600 + m*60 + s;
+     }
+
+     /* If-None-Match compares weakly, so any coding of the asset matches */
+
+     bool fresh( string_t match, string_t since, ptr_t<asset_t> item ) noexcept {
+          if( !match.empty() ){ return match=="*" || regex::test( match, item->etag.slice( 0, item->etag.last() ) + "(-[a-z]+)?\"" ); }
+          ulong time = since.empty() ? 0 : parse_date( since ); return time > 0 && item->mtime <= time;
+     }
+
+     /* a strong validator names one representation, so an encoded body gets
+        its coding appended to the ETag: "1f-2a" goes out as "1f-2a-gzip" */
+
+     void coded_etag( header_t& headers ) noexcept { string_t key, tag, enc;
+          forEach( item, headers.data() ){
+                 if( item.first.size()==4  && regex::test( item.first, "^etag$", true ) ){ key = item.first; tag = item.second; }
+               elif( item.first.size()==16 && regex::test( item.first, "^content-encoding$", true ) ){ enc = item.second; }
+          }    if( enc.empty() || tag.size() < 2 || tag[0] != '"' || regex::test( enc, "^identity$", true ) ){ return; }
+          headers[ key ] = tag.slice( 0, tag.last() ) + "-" + enc + "\"";
+     }
+
+     ulong weight( ptr_t<asset_t> item ) noexcept {
+          return item->data.size() + item->gzip.size() + item->br.size();
+     }
+
+     /*.........................................................................*/
+
+     struct range_t { ulong begin=0, end=0; };
+
+     /* RFC 7233 byte ranges, `end` is exclusive; returns 0 when the header
+        must be ignored, -1 when nothing is satisfiable ( 416 ) and 1 with
+        the satisfiable ranges in `out`. */
+
+     int ranges( string_t header, ulong size, array_t<range_t>& out ) noexcept {
+          if( !regex::test( header, "^\\s*bytes\\s*=", true ) ){ return 0; } ulong eq = 0;
+          while( header[eq] != '=' ){ eq++; } auto list = regex::match_all( header.slice( eq+1 ), "[^,]+" );
+          if( list.empty() || list.size() > 16 ){ return 0; }
+
+          for( ulong x=0; x<list.size(); x++ ){
+               auto spec = regex::match( list[x], "[0-9]*-[0-9]*" ); range_t item;
+               if( spec.empty() || spec == "-" ){ return 0; }
+               auto first = regex::match( spec, "^[0-9]+" ), last = regex::match( spec, "[0-9]+$" );
+
+               if( first.empty() ){ ulong len = string::to_ulong( last );
+                   if( len == 0 || size == 0 ){ continue; }
+                   item.begin = size > len ? size-len : 0; item.end = size;
+               } else { item.begin = string::to_ulong( first ); 
+                   if( !last.empty() && string::to_ulong( last ) < item.begin ){ return 0; }
+                   if( item.begin >= size ){ continue; }
+                   item.end = last.empty() ? size : min( string::to_ulong( last )+1, size );
+               }   out.push( item );
+          }
+
+          return out.empty() ? -1 : 1;
+     }
+
+     /* If-Range carries either a strong ETag or the Last-Modified date; ranges
+        are always sent without a coding so only the plain ETag matches */
+
+     bool if_range( string_t value, ptr_t<asset_t> item ) noexcept {
+          if( value.empty() ){ return true; }
+          if( regex::test( value, "^W/" ) ){ return false; }
+          if( value[0] == '"' ){ return value == item->etag; }
+          return value == item->date;
+     }
+
+     GENERATOR( byteranges ) {
+     protected:
+
+          ptr_t<bool> state = new bool(0); ulong x;
+
+     public:
+
+          template< class T >
+          coEmit( T& cli, string_t dir, array_t<range_t>& list, array_t<string_t>& part ){
+          gnStart
+
+               for( x=0; x<list.size(); x++ ){ cli.write( part[x] ); do {
+                    auto flag = state; file_t file ( dir, "r" ); *flag = 1;
+                    file.set_range( list[x].begin, list[x].end );
+                    file.onData([=]( string_t data ){ cli.write( data ); });
+                    file.onDrain.once([=](){ *flag = 0; }); stream::pipe( file );
+               } while(0); while( *state==1 ){ coNext; } }
+
+               cli.write( part[x] ); cli.finish();
+
+          gnStop
+          }
+
+     };
+
+     /* resolved assets are kept by request path and revalidated with a single
+        stat(); files up to `max` bytes also keep their body and encodings in
+        memory as long as the pool stays under `limit` bytes. */
+
+     ptr_t<asset_t> asset( ptr_t<assets_t> pool, string_t base, string_t pth ) noexcept {
+
+          ulong size=0, mtime=0; auto item = pool->cache.get( 0, base, pth );
+          if( !item.null() ){
+          if( stat_file( item->dir, size, mtime ) && size==item->size && mtime==item->mtime ){ return item; }
+              pool->cache.erase( 0, base, pth ); pool->used -= weight( item );
+          }
+
+          auto dir = pth.empty() ? path::join( base, "" ) :
+                                   path::join( base,pth ) ;
+          item = new asset_t();
+
+          if ( dir.empty() ){ dir = path::join( base, "index.html" ); }
+          if ( dir[dir.last()] == '/' ){ dir += "index.html"; }
+
+          if( fs::exists_file(dir+".html") == true ){ dir += ".html"; }
+          if( fs::exists_file(dir) == false || dir == base ){ item->status = 404;
+          if( fs::exists_file( path::join( base, "404.html" ) )){
+              dir = path::join( base, "404.html" );
+          } else { return ptr_t<asset_t>(); }}
+
+          if( !stat_file( dir, size, mtime ) ){ return ptr_t<asset_t>(); }
+          item->dir  = dir; item->type = path::mimetype( dir );
+          item->size = size; item->mtime= mtime; item->date = http_date( mtime );
+          item->etag = string::format( "\"%lx-%lx\"", mtime, size );
+          if( item->status != 200 ){ return item; }
+
+          if( size <= pool->max && pool->used + size <= pool->limit && 
+              !regex::test( item->type, "html|audio|video", true ) ){
+               auto file = fs::readable( dir ); item->data = stream::await( file ); item->memory = true;
+               item->etag = string::format( "\"%lx-%lx\"", hash( item->data.get(), item->data.size() ), size );
+               if( fs::exists_file( dir+".br" ) ){ auto side = fs::readable( dir+".br" ); item->br   = stream::await( side ); }
+               if( fs::exists_file( dir+".gz" ) ){ auto side = fs::readable( dir+".gz" ); item->gzip = stream::await( side ); }
+             elif( regex::test( item->type, "text|javascript|json|xml|svg", true ) ){ item->gzip = zlib::gzip::get( item->data ); }
+          #ifdef NODEPP_EXPRESS_BROTLI
+               if( item->br.empty() && !item->gzip.empty() ){ item->br = zstream_t( ENCODING_BR, 9 ).end( item->data ); }
+          #endif
+          }
+
+          auto prev = pool->cache.set( 0, base, pth, item ); pool->used += weight( item );
+          if( !prev.null() ){ pool->used -= weight( prev ); } return item;
+     }
+
+}}
+#endif
+
+/*────────────────────────────────────────────────────────────────────────────*/
+
+#ifndef NODEPP_EXPRESS_SENDFILE
+#define NODEPP_EXPRESS_SENDFILE
+#if defined(__linux__)
+#include <sys/sendfile.h>
+namespace nodepp { namespace _express_ { 
+
+     GENERATOR( sendfile ) {
+     protected:
+
+          off_t pos; ulong end; long c;
+
+     public:
+
+          template< class T, class V >
+          coEmit( T& cli, V& file, ulong begin, ulong finish ){
+          gnStart pos = begin; end = finish;
+
+               while( (ulong)pos < end ){
+                    c = ::sendfile( cli.get_fd(), file.get_fd(), &pos, end-pos );
+                    if( c > 0 ){ continue; }
+                    if( c < 0 && ( errno==EAGAIN || errno==EWOULDBLOCK || errno==EINTR ) )
+                      { coNext; continue; } break;
+               }
+
+                 if( (ulong)pos == end ){ cli.finish(); }
+               elif( (ulong)pos == begin ){ file.set_range( begin, end );
+                    file.onData([=]( string_t data ){ cli.write( data ); });
+                    file.onDrain.once([=](){ cli.finish(); }); stream::pipe( file );
+               } else { cli.close(); }
+
+          gnStop
+          }
+
+     };
+
+}}
+#endif
+#endif
+
+/*────────────────────────────────────────────────────────────────────────────*/
+
+#ifndef NODEPP_EXPRESS_WRITEV
+#define NODEPP_EXPRESS_WRITEV
+#if !defined(_WIN32)
+#include <sys/uio.h>
+namespace nodepp { namespace _express_ { 
+
+     template< class T >
+     ulong writev( T& cli, string_t& head, string_t& body ) noexcept {
+          struct iovec io[2]; long c;
+          io[0].iov_base = head.get(); io[0].iov_len = head.size();
+          io[1].iov_base = body.get(); io[1].iov_len = body.size();
+          do { c = ::writev( cli.get_fd(), io, 2 ); } while( c<0 && errno==EINTR );
+          return c<0 ? 0 : c;
+     }
+
+}}
+#endif
+#endif
+
+/*────────────────────────────────────────────────────────────────────────────*/
+
+#ifndef NODEPP_EXPRESS_KEEPALIVE
+#define NODEPP_EXPRESS_KEEPALIVE
+namespace nodepp { namespace _express_ { 
+
+     /* a Content-Length body may keep the socket open, the response
+        falls back to Connection: close if it was not fully read */
+
+     template< class T >
+     bool keep_alive( T& cli ) noexcept {
+          auto conn = cli.headers["Connection"];
+          if( !cli.headers["Transfer-Encoding"].empty() )            { return false; }
+          if( regex::test( conn, "close", true ) )                   { return false; }
+          if( cli.protocol == "HTTP/1.1" )                           { return true;  }
+          return regex::test( conn, "keep-alive", true );
+     }
+
+     template< class T >
+     bool idempotent( T& cli ) noexcept {
+          return ( cli.method == "GET" || cli.method == "HEAD" ) &&
+                 regex::test( cli.headers["Content-Length"], "^0*$" );
+     }
+
+     string_t reason( uint status ) noexcept {
+          switch( status ){
+               case 100: return "Continue";              case 101: return "Switching Protocols";
+               case 200: return "OK";                    case 201: return "Created";
+               case 202: return "Accepted";              case 204: return "No Content";
+               case 206: return "Partial Content";       case 301: return "Moved Permanently";
+               case 302: return "Found";                 case 303: return "See Other";
+               case 304: return "Not Modified";          case 307: return "Temporary Redirect";
+               case 308: return "Permanent Redirect";    case 400: return "Bad Request";
+               case 401: return "Unauthorized";          case 403: return "Forbidden";
+               case 404: return "Not Found";             case 405: return "Method Not Allowed";
+               case 408: return "Request Timeout";       case 409: return "Conflict";
+               case 410: return "Gone";                  case 411: return "Length Required";
+               case 412: return "Precondition Failed";   case 413: return "Payload Too Large";
+               case 415: return "Unsupported Media Type";case 416: return "Range Not Satisfiable";
+               case 429: return "Too Many Requests";     case 500: return "Internal Server Error";
+               case 501: return "Not Implemented";       case 502: return "Bad Gateway";
+               case 503: return "Service Unavailable";   case 504: return "Gateway Timeout";
+               default : return "Unknown";
+          }
+     }
+
+     string_t head( uint status, header_t& headers ) noexcept {
+          string_t out = string::format( "HTTP/1.1 %u %s\r\n", status, reason(status).get() );
+          forEach( item, headers.data() ){ out += item.first + ": " + item.second + "\r\n"; }
+          return out + "\r\n";
+     }
+
+     /* responses of one connection leave in request order: the oldest
+        one writes through, younger ones queue their output in a slot
+        until every response before them has finished */
+
+     class pipeline_t {
+     public:
+
+          struct SLOT {
+               array_t<string_t> data;
+               bool done=false, close=false;
+          };
+
+          array_t<SLOT> slot; ulong head=0, tail=0, count=0, wait=0; bool stop=false;
+
+          pipeline_t( ulong size ) noexcept { do { slot.push( SLOT() ); } while( slot.size() < size ); }
+
+          bool  busy() const noexcept { return head < tail; }
+
+          bool  full() const noexcept { return tail-head >= slot.size(); }
+
+          ulong push() noexcept { slot[ tail % slot.size() ] = SLOT(); return tail++; }
+
+          SLOT& operator[]( ulong seq ) noexcept { return slot[ seq % slot.size() ]; }
+
+     };
+
+     GENERATOR( idle ) {
+     protected:
+
+          ulong stamp; int c;
+
+     public:
+
+          template< class T, class V, class U >
+          coEmit( T& cli, ulong timeout, V& pipe, U& cb ){
+          gnStart
+
+               while( pipe->wait || pipe->full() ){ coNext; } stamp = process::now();
+
+               while( (c=cli.read_header())==1 ){
+                      if( pipe->busy() ){ stamp = process::now(); }
+                    elif( process::now()-stamp >= timeout ){ break; } coNext;
+               }
+
+               if( c==0 ){ cb( cli ); } else { pipe->stop = true;
+               if( !pipe->busy() ){ cli.close(); } }
+
+          gnStop
+          }
+
+     };
+
+}}
+#endif
+
+/*────────────────────────────────────────────────────────────────────────────*/
+
+#ifndef NODEPP_EXPRESS_BODY
+#define NODEPP_EXPRESS_BODY
+#ifndef NODEPP_EXPRESS_BODY_TIMEOUT
+#define NODEPP_EXPRESS_BODY_TIMEOUT 30000
+#endif
+
+#ifndef NODEPP_EXPRESS_FORM_LIMIT
+#define NODEPP_EXPRESS_FORM_LIMIT CHUNK_MB(1)
+#endif
+
+namespace nodepp { namespace _express_ {
+
+     struct part_t { string_t name, filename, type, data, path; ulong size=0; };
+
+     struct body_t { object_t json; query_t form; array_t<part_t> files; };
+
+     long find( const string_t& data, ulong from, const string_t& pat ) noexcept {
+          if( pat.empty() || data.size() < pat.size() ){ return -1; }
+          const char* bf = data.get(); ulong end = data.size() - pat.size();
+          while( from <= end ){
+               auto pos = (const char*) memchr( bf+from, pat[0], end-from+1 );
+               if( pos == nullptr ){ return -1; } from = pos - bf;
+               if( memcmp( pos, pat.get(), pat.size() )==0 ){ return from; } from++;
+          }    return -1;
+     }
+
+     int unhex( char c ) noexcept {
+            if( c >= '0' && c <= '9' ){ return c - '0'; }
+          elif( c >= 'a' && c <= 'f' ){ return c - 'a' + 10; }
+          elif( c >= 'A' && c <= 'F' ){ return c - 'A' + 10; } return -1;
+     }
+
+     string_t unescape( string_t data ) noexcept {
+          if( memchr( data.get(), '%', data.size() )==nullptr &&
+              memchr( data.get(), '+', data.size() )==nullptr ){ return data; }
+          string_t out ( data.size(), '\0' ); ulong n=0;
+          for( ulong x=0; x<data.size(); x++ ){ char c = data[x];
+            if( c == '+' ){ c = ' '; }
+          elif( c == '%' && x+2 < data.size() && unhex(data[x+1])>=0 && unhex(data[x+2])>=0 )
+              { c = unhex(data[x+1])*16 + unhex(data[x+2]); x+=2; }
+               out[n++] = c;
+          }    return out.slice( 0, n );
+     }
+
+     /*.........................................................................*/
+
+     /* request bodies are read in place: a Content-Length body is never
+        read past its last byte and a chunked one is decoded as it arrives */
+
+     class inflow_t {
+     public:
+
+          ptr_t<char> bf = ptr_t<char>( CHUNK_KB(16) );
+          ulong remain=0, total=0, limit=0, line=0, stamp=0; uchar state=0;
+          bool  chunked=false, digit=false;
+
+          /* 1 needs more input, 0 reached the last chunk, -1 stops with `code` */
+
+          template< class T >
+          int decode( const char* data, ulong len, T& cb, uint& code ) noexcept {
+               ulong x=0; while( x < len ){ char c = data[x]; switch( state ){
+
+                    case 0: x++; if( unhex(c) >= 0 ){
+                         if( remain > ( (ulong)-1 >> 4 ) ){ code = 400; return -1; }
+                         remain = remain*16 + unhex(c); digit = true;
+                    } elif( c == ';' || c == ' ' || c == '\t' ){ state = 1; }
+                      elif( c == '\n' ){ if( !digit ){ code = 400; return -1; } state = remain==0 ? 4 : 2; }
+                      elif( c != '\r' ){ code = 400; return -1; } break;
+
+                    case 1: x++; if( c == '\n' ){ state = remain==0 ? 4 : 2; } break;
+
+                    case 2: { ulong n = min( remain, len-x ); total += n;
+                         if( total > limit ){ code = 413; return -1; }
+                         if( (code=cb( string_t( data+x, n ) )) != 0 ){ return -1; }
+                         x += n; remain -= n; if( remain==0 ){ state = 3; }
+                    } break;
+
+                    case 3: x++; if( c == '\n' ){ state = 0; digit = false; } break;
+
+                    default: x++; if( c == '\n' ){ if( line==0 ){ return 0; } line = 0; }
+                             elif( c != '\r' ){ line++; } break;
+
+               }}   return 1;
+          }
+
+     };
+
+     /*.........................................................................*/
+
+     /* bodies that can't be parsed chunk by chunk land in one buffer sized
+        from Content-Length, so the raw body is never copied a second time */
+
+     class collect_t {
+     protected:
+
+          string_t data; ulong size=0;
+
+     public:
+
+          collect_t( ulong length ) noexcept { if( length>0 ){ data = string_t( length, '\0' ); } }
+
+          void push( string_t chunk ) noexcept {
+               if( size+chunk.size() > data.size() ){
+                    string_t next ( max( data.size()*2, size+chunk.size() ), '\0' );
+                    if( size > 0 ){ memcpy( next.get(), data.get(), size ); } data = next;
+               }    memcpy( data.get()+size, chunk.get(), chunk.size() ); size += chunk.size();
+          }
+
+          string_t get() const noexcept { return size==data.size() ? data : data.slice( 0, size ); }
+
+     };
+
+     class urlencoded_t {
+     protected:
+
+          string_t part;
+
+          void pair( string_t data ) noexcept { if( data.empty() ){ return; }
+               auto pos = (const char*) memchr( data.get(), '=', data.size() );
+               if( pos == nullptr ){ form[ unescape( data ) ] = ""; return; } ulong eq = pos - data.get();
+               form[ unescape( data.slice( 0, eq ) ) ] = unescape( data.slice( eq+1 ) );
+          }
+
+     public: query_t form;
+
+          void push( string_t data ) noexcept { ulong x=0; const char* bf = data.get();
+               while( x < data.size() ){
+                    auto pos = (const char*) memchr( bf+x, '&', data.size()-x );
+                    if( pos == nullptr ){ part += data.slice( x ); return; } ulong y = pos - bf;
+                    pair( part.empty() ? data.slice( x, y ) : part + data.slice( x, y ) );
+                    part = nullptr; x = y+1;
+               }
+          }
+
+          void end() noexcept { pair( part ); part = nullptr; }
+
+     };
+
+     /*.........................................................................*/
+
+     /* a multipart body is split on "\r\n--boundary" as it streams in; only
+        the bytes that might still be the start of a delimiter are held back */
+
+     class multipart_t {
+     protected:
+
+          string_t delim, pending = "\r\n"; uchar state=0;
+
+          string_t param( string_t line, string_t key ) const noexcept {
+               ulong x=0; while( x < line.size() ){
+                    while( x < line.size() && ( line[x]==';' || line[x]==' ' ) ){ x++; }
+                    ulong y=x; while( y < line.size() && line[y]!='=' && line[y]!=';' ){ y++; }
+                    bool match = y-x == key.size() && regex::test( line.slice( x, y ), "^"+key+"$", true ); x = y;
+                    if( x >= line.size() || line[x] == ';' ){ continue; } x++;
+                    if( x < line.size() && line[x] == '"' ){
+                         y = ++x; while( y < line.size() && line[y]!='"' ){ y++; }
+                    } else { y = x; while( y < line.size() && line[y]!=';' ){ y++; } }
+                    if( match ){ return line.slice( x, y ); } x = y+1;
+               }    return nullptr;
+          }
+
+          void headers( string_t block ) noexcept {
+               part = part_t(); ulong x=0; while( x < block.size() ){
+                    auto pos = find( block, x, "\r\n" ); ulong y = pos<0 ? block.size() : pos;
+                    auto line = block.slice( x, y ); x = y+2;
+                      if( regex::test( line, "^content-disposition:", true ) ){
+                          part.name = param( line.slice(20), "name" ); part.filename = param( line.slice(20), "filename" );
+                  } elif( regex::test( line, "^content-type:", true ) ){
+                          part.type = regex::replace( line.slice(13), "^[ \t]+", "" );
+                  }
+               }
+          }
+
+     public: part_t part;
+
+          function_t<uint,part_t&>          onPart = []( part_t& ){ return 0u; };
+          function_t<uint,part_t&,string_t> onData = []( part_t&, string_t ){ return 0u; };
+          function_t<uint,part_t&>          onEnd  = []( part_t& ){ return 0u; };
+
+          multipart_t( string_t boundary ) noexcept : delim( "\r\n--" + boundary ) {}
+
+          bool is_done() const noexcept { return state == 4; }
+
+          uint push( string_t data ) noexcept {
+               string_t buf = pending.empty() ? data : pending + data;
+               pending = nullptr; ulong x=0; uint code=0;
+
+               while( x < buf.size() && state != 4 ){ switch( state ){
+
+                    case 0: { auto pos = find( buf, x, delim ); if( pos<0 ){
+                         ulong end = buf.size()+1>delim.size() ? buf.size()+1-delim.size() : 0;
+                         pending = buf.slice( max( x, end ) ); return 0;
+                    }    x = pos+delim.size(); state = 1; } break;
+
+                    case 1: if( buf.size()-x < 2 ){ pending = buf.slice( x ); return 0; }
+                              if( buf[x]=='-' && buf[x+1]=='-' ){ state = 4; }
+                            elif( buf[x]=='\r' && buf[x+1]=='\n' ){ state = 2; x+=2; }
+                            else { return 400; } break;
+
+                    case 2: { auto pos = find( buf, x, "\r\n\r\n" ); if( pos<0 ){
+                         if( buf.size()-x > CHUNK_KB(16) ){ return 431; } pending = buf.slice( x ); return 0;
+                    }    headers( buf.slice( x, pos ) ); x = pos+4; state = 3;
+                         if( part.name.empty() ){ return 400; }
+                         if( (code=onPart( part )) != 0 ){ return code; } } break;
+
+                    case 3: { auto pos = find( buf, x, delim ); ulong end = pos<0 ?
+                         ( buf.size()+1>delim.size() ? buf.size()+1-delim.size() : 0 ) : pos;
+                         if( end > x ){ part.size += end-x;
+                         if( (code=onData( part, buf.slice( x, end ) )) != 0 ){ return code; }}
+                         if( pos<0 ){ pending = buf.slice( max( x, end ) ); return 0; }
+                         if( (code=onEnd( part )) != 0 ){ return code; } x = pos+delim.size(); state = 1;
+                    } break;
+
+               }}   return 0;
+          }
+
+     };
+
+
+     /*.........................................................................*/
+
+     /* uploaded parts wait here between the socket and the stream `open`
+        returned for them, the socket is only read again while less than
+        `max` bytes are queued, so memory stays flat whatever the size */
+
+     class spool_t {
+     protected:
+
+          struct ITEM { file_t file; string_t data; bool close=false; };
+
+          array_t<ITEM> queue; ulong head=0, off=0;
+
+     public:
+
+          function_t<file_t,part_t&> open; file_t file; ulong size=0, max=CHUNK_KB(64);
+
+          spool_t( function_t<file_t,part_t&> open ) noexcept : open( open ) {}
+
+          bool full() const noexcept { return size >= max; }
+
+          void push( string_t data, bool close ) noexcept {
+               ITEM item; item.file = file; item.data = data; item.close = close;
+               queue.push( item ); size += data.size();
+          }
+
+          /* 1 still has data queued, 0 drained, -1 a stream failed */
+
+          int drain() noexcept {
+               while( head < queue.size() ){ auto& item = queue[head];
+                    if( off < item.data.size() ){
+                        int c = item.file._write_( item.data.get()+off, item.data.size()-off );
+                        if( c == -2 ){ return 1; } if( c <= 0 ){ return -1; }
+                        off += c; size -= c; continue;
+                    }   if( item.close ){ item.file.close(); } head++; off = 0;
+               }    queue = array_t<ITEM>(); head = 0; return 0;
+          }
+
+     };
+
+     /* fields are kept in the body form, file parts stay in memory when
+        there is no spool and are written through it otherwise; field names
+        and values together stay under NODEPP_EXPRESS_FORM_LIMIT bytes
+        whatever the body limit is, so only file data grows with it */
+
+     template< class T >
+     void multipart( T& cli, ulong limit, ptr_t<spool_t> spool, function_t<void> next ) noexcept {
+          auto bound = regex::match( cli.headers["Content-Type"], "boundary=[^;]+", true );
+          if( !bound.empty() ){ bound = regex::replace_all( bound.slice( 9 ), "[\" ]", "" ); }
+          if( bound.empty() ){ cli.status( 400 ).send( reason( 400 ) ); return; }
+          ptr_t<multipart_t> parser = new multipart_t( bound ); auto self = cli;
+          ptr_t<ulong> text = new ulong(0);
+
+          parser->onPart = [=]( part_t& part ){
+               if( part.filename.empty() ){ *text += part.name.size()+1;
+                   return *text > NODEPP_EXPRESS_FORM_LIMIT ? 413u : 0u;
+               }   if( spool.null() ){ return 0u; }
+               try { spool->file = spool->open( part ); } catch(...) { return 500u; }
+               return spool->file.is_closed() ? 500u : 0u;
+          };
+
+          parser->onData = [=]( part_t& part, string_t data ){
+               if( part.filename.empty() ){ auto& field = self.body().form[ part.name ]; *text += data.size();
+                   if( field.size()+data.size() > CHUNK_KB(64) || *text > NODEPP_EXPRESS_FORM_LIMIT ){ return 413u; }
+                   field += data; return 0u;
+               }   if( spool.null() ){ part.data += data; } else { spool->push( data, false ); } return 0u;
+          };
+
+          parser->onEnd = [=]( part_t& part ){
+               if( part.filename.empty() ){ return 0u; } self.body().files.push( part );
+               if( !spool.null() ){ spool->push( nullptr, !part.path.empty() ); } return 0u;
+          };
+
+          function_t<void,uint> fail = [=]( uint code ){
+               if( !spool.null() ){ spool->file.close(); auto& list = self.body().files;
+               for( ulong x=0; x<list.size(); x++ ){ if( !list[x].path.empty() ){ fs::remove_file( list[x].path ); } }
+                   if( !parser->part.path.empty() ){ fs::remove_file( parser->part.path ); }
+               }   self.status( code ).send( reason( code ) );
+          };
+
+          function_t<int> wait = [=](){ if( spool.null() ){ return 0; }
+               int c = spool->drain(); return c<0 ? -1 : spool->full() ? 1 : 0;
+          };
+
+          cli.readBody( limit, [=]( string_t chunk ){ return parser->push( chunk ); }, [=]( uint code ){
+               if( code == 0 && !parser->is_done() ){ code = 400; }
+               if( code != 0 ){ fail( code ); return; } if( spool.null() ){ next(); return; }
+               process::poll::add([=](){ int c = spool->drain(); if( c > 0 ){ return 1; }
+                    if( c < 0 ){ fail( 500 ); } else { next(); } return -1;
+               });
+          }, wait );
+     }
+
+}}
+#endif
+
+/*────────────────────────────────────────────────────────────────────────────*/
+
+#ifndef NODEPP_EXPRESS_UPSTREAM
+#define NODEPP_EXPRESS_UPSTREAM
+namespace nodepp { namespace _express_ {
+
+     struct reply_t { uint status=0; header_t headers; };
+
+     class call_t {
+     public:
+
+          string_t method="GET", url, body, key, host, authority, path;
+          header_t headers; ulong port=0; bool tls=false, reused=false, fresh=false;
+
+          function_t<void,reply_t&> onHead = []( reply_t& ){};
+          function_t<void,string_t> onData = []( string_t ){};
+          function_t<void,uint>     onEnd  = []( uint ){};
+
+          /* splits scheme://host[:port]/path?query, the origin key is what
+             connections are pooled under */
+
+          bool parse() noexcept {
+               auto pos = find( url, 0, "://" ); if( pos < 0 ){ return false; }
+               auto scheme = url.slice( 0, pos ); tls = regex::test( scheme, "^https$", true );
+               if( !tls && !regex::test( scheme, "^http$", true ) ){ return false; }
+
+               ulong x = pos+3, y = x; while( y < url.size() && url[y]!='/' && url[y]!='?' && url[y]!='#' ){ y++; }
+               authority = url.slice( x, y ); path = y<url.size() && url[y]!='#' ? url.slice( y ) : "/";
+               if( path[0] == '?' ){ path = "/" + path; } auto hash = find( path, 0, "#" );
+               if( hash >= 0 ){ path = path.slice( 0, hash ); }
+
+               auto colon = find( authority, 0, ":" ); host = authority; port = tls ? 443 : 80;
+               if( authority[0] == '[' ){ auto end = find( authority, 0, "]" ); if( end < 0 ){ return false; }
+                   host = authority.slice( 1, end ); colon = find( authority, end, ":" ); }
+               elif( colon >= 0 ){ host = authority.slice( 0, colon ); }
+               if( colon >= 0 ){ port = string::to_ulong( authority.slice( colon+1 ) ); }
+
+               key = string::format( "%s://%s:%lu", tls ? "https" : "http", host.get(), port );
+               return !host.empty() && port > 0;
+          }
+
+     };
+
+     /*.........................................................................*/
+
+     /* one request on one upstream connection: the head is read up to the
+        blank line, the body is framed by Content-Length or chunked coding
+        and the connection is only parked again when it ended cleanly */
+
+     class exchange_t {
+     protected:
+
+          ptr_t<inflow_t> flow = new inflow_t(); string_t buf; reply_t rep;
+          ulong remain=0, stamp=0; uchar state=0, mode=2; bool keep=false, got=false;
+
+          string_t request( call_t& call ) const noexcept {
+               auto out = call.method + " " + call.path + " HTTP/1.1\r\nHost: " + call.authority + "\r\n";
+               forEach( item, call.headers.data() ){
+               if( regex::test( item.first, "^(host|connection|content-length|transfer-encoding)$", true ) ){ continue; }
+                    out += item.first + ": " + item.second + "\r\n";
+               }    if( !call.body.empty() ){ out += "Content-Length: " + string::to_string( call.body.size() ) + "\r\n"; }
+               return out + "Connection: keep-alive\r\n\r\n" + call.body;
+          }
+
+          bool head( string_t block, call_t& call ) noexcept {
+               auto pos = find( block, 0, "\r\n" ); ulong x = pos<0 ? block.size() : pos;
+               auto line = block.slice( 0, x ); x += 2; bool length = false;
+               if( !regex::test( line, "^HTTP/1\\.[01] [0-9][0-9][0-9]" ) ){ return false; }
+               rep.status = string::to_ulong( line.slice( 9, 12 ) ); keep = line[7] == '1';
+
+               while( x < block.size() ){ pos = find( block, x, "\r\n" ); ulong y = pos<0 ? block.size() : pos;
+                    line = block.slice( x, y ); x = y+2; auto col = find( line, 0, ":" ); if( col<0 ){ continue; }
+                    auto name = line.slice( 0, col ), value = regex::replace( line.slice( col+1 ), "^[ \t]+", "" );
+                    rep.headers[ name ] = value;
+                      if( regex::test( name, "^content-length$", true ) ){ remain = string::to_ulong( value ); length = true; }
+                    elif( regex::test( name, "^transfer-encoding$", true ) ){ if( regex::test( value, "chunked", true ) ){ mode = 1; } }
+                    elif( regex::test( name, "^connection$", true ) ){
+                            if( regex::test( value, "close", true ) ){ keep = false; }
+                          elif( regex::test( value, "keep-alive", true ) ){ keep = true; }
+                    }
+               }
+
+               if( mode != 1 && length ){ mode = 0; } if( mode == 2 ){ keep = false; }
+               if( call.method == "HEAD" || rep.status < 200 || rep.status == 204 || rep.status == 304 )
+                 { mode = 0; remain = 0; } flow->limit = (ulong)-1; return true;
+          }
+
+          int body( string_t data, call_t& call ) noexcept {
+               if( mode == 0 ){ ulong n = min( remain, data.size() ); remain -= n;
+                   if( n > 0 ){ call.onData( data.slice( 0, n ) ); }
+                   if( remain > 0 ){ return 1; } call.onEnd( 0 ); return 0;
+               }
+
+               if( mode == 1 ){ uint code = 0;
+                   function_t<uint,string_t> cb = [&]( string_t chunk ){ call.onData( chunk ); return 0u; };
+                   int c = flow->decode( data.get(), data.size(), cb, code );
+                   if( c < 0 ){ return -1; } if( c > 0 ){ return 1; } call.onEnd( 0 ); return 0;
+               }
+
+               if( !data.empty() ){ call.onData( data ); } return 1;
+          }
+
+     public:
+
+          bool is_reusable() const noexcept { return keep && state == 3; }
+
+          bool is_fresh() const noexcept { return !got; }
+
+          /* ms since the request went out or the last byte came back */
+
+          ulong idle() const noexcept { return process::now() - stamp; }
+
+          /* 1 keeps polling, 0 the response is complete, -1 it failed */
+
+          template< class T >
+          int step( T& cli, call_t& call ) noexcept {
+               if( state == 0 ){ cli.write( request( call ) ); state = 1; stamp = process::now(); }
+
+               ulong size = state == 2 && mode == 0 ? min( remain, (ulong) CHUNK_KB(16) ) : CHUNK_KB(16);
+               if( state == 2 && mode == 0 && remain == 0 ){ state = 3; call.onEnd( 0 ); return 0; }
+
+               int c = cli._read_( flow->bf.get(), size ); if( c == -2 ){ return 1; }
+               if( c <= 0 ){ if( state == 2 && mode == 2 ){ call.onEnd( 0 ); return 0; } return -1; }
+               got = true; stamp = process::now(); string_t data ( flow->bf.get(), c );
+
+               if( state == 1 ){ buf += data; auto pos = find( buf, 0, "\r\n\r\n" );
+                   if( pos < 0 ){ return buf.size() > CHUNK_KB(64) ? -1 : 1; }
+                   if( !head( buf.slice( 0, pos ), call ) ){ return -1; }
+                   data = buf.slice( pos+4 ); buf = nullptr; state = 2; call.onHead( rep );
+                   if( mode == 0 && remain == 0 ){ state = 3; call.onEnd( 0 ); return 0; }
+                   if( data.empty() ){ return 1; }
+               }
+
+               c = body( data, call ); if( c == 0 ){ state = 3; } return c;
+          }
+
+     };
+
+     /*.........................................................................*/
+
+     /* idle connections are parked per origin and handed to the next
+        request for it; `per_host` bounds open plus parked connections
+        and parked ones are dropped after `timeout` ms. A connect, a wait
+        for a free slot or a silence on the reply longer than `deadline`
+        ms ends the request with 504 so a hung origin cannot hold slots */
+
+     template< class T > class upstream_t {
+     protected:
+
+          struct ORIGIN { array_t<T> idle; array_t<ulong> stamp; ulong active=0; };
+
+          map_t<string_t,ptr_t<ORIGIN>> list;
+
+          ptr_t<ORIGIN> origin( string_t key ) noexcept {
+               auto& item = list[ key ]; if( item.null() ){ item = new ORIGIN(); } return item;
+          }
+
+     public: ulong max_idle=16, per_host=32, timeout=30000, deadline=10000;
+
+          bool take( string_t key, T& out ) noexcept { auto item = origin( key );
+               while( !item->idle.empty() ){
+                    out = item->idle[ item->idle.last() ]; ulong stamp = item->stamp[ item->stamp.last() ];
+                    item->idle.pop(); item->stamp.pop();
+                    if( process::now()-stamp < timeout && out.is_available() ){ item->active++; return true; }
+                    out.close();
+               }    return false;
+          }
+
+          bool ready( string_t key ) noexcept { auto item = origin( key );
+               return !item->idle.empty() || item->active + item->idle.size() < per_host;
+          }
+
+          bool reserve( string_t key ) noexcept { auto item = origin( key );
+               if( item->active + item->idle.size() >= per_host ){ return false; } item->active++; return true;
+          }
+
+          void release( string_t key, T cli, bool reuse ) noexcept { auto item = origin( key ); item->active--;
+               if( reuse && cli.is_available() && item->idle.size() < max_idle ){
+                   item->idle.push( cli ); item->stamp.push( process::now() );
+               } else { cli.close(); }
+          }
+
+          void drop( string_t key ) noexcept { origin( key )->active--; }
+
+     };
+
+     template< class T >
+     ptr_t<upstream_t<T>> upstream() noexcept {
+          static ptr_t<upstream_t<T>> pool = new upstream_t<T>(); return pool;
+     }
+
+     /* every TLS upstream shares this context instead of building one per request */
+
+     ssl_t* upstream_ssl() noexcept { static ssl_t ssl; return &ssl; }
+
+     void fetch( ptr_t<call_t> call ) noexcept;
+
+     void connect( ptr_t<call_t> call, function_t<void,http_t> cb, function_t<void> fail ) noexcept {
+          tcp_t client ([=]( http_t cli ){ cb( cli ); });
+          client.onError([=]( ... ){ fail(); }); client.connect( call->host, call->port );
+     }
+
+     void connect( ptr_t<call_t> call, function_t<void,https_t> cb, function_t<void> fail ) noexcept {
+          tls_t client ([=]( https_t cli ){ cb( cli ); }, upstream_ssl() );
+          client.onError([=]( ... ){ fail(); }); client.connect( call->host, call->port );
+     }
+
+     /* a parked connection the peer already closed fails before any byte
+        comes back, that request is replayed once on a new connection */
+
+     template< class T >
+     void exchange( ptr_t<call_t> call, T cli ) noexcept {
+          ptr_t<exchange_t> item = new exchange_t(); auto pool = upstream<T>();
+          process::poll::add([=](){ T conn = cli; int c = item->step( conn, *call );
+               if( c == 1 && item->idle() >= pool->deadline ){ pool->release( call->key, conn, false ); call->onEnd( 504 ); return -1; }
+               if( c == 1 ){ return 1; } pool->release( call->key, conn, c == 0 && item->is_reusable() );
+               if( c == 0 ){ return -1; }
+               if( call->reused && item->is_fresh() && idempotent( *call ) ){ call->fresh = true; fetch( call ); return -1; }
+               call->onEnd( 502 ); return -1;
+          });
+     }
+
+     template< class T >
+     void open( ptr_t<call_t> call ) noexcept { auto pool = upstream<T>(); T cli;
+          if( !call->fresh && pool->take( call->key, cli ) ){ call->reused = true; exchange( call, cli ); return; }
+          call->reused = false;
+
+          if( !pool->reserve( call->key ) ){ ulong stamp = process::now();
+              process::poll::add([=](){ if( process::now()-stamp >= pool->deadline ){ call->onEnd( 504 ); return -1; }
+                   if( !pool->ready( call->key ) ){ return 1; } open<T>( call ); return -1;
+              }); return;
+          }
+
+          /* 0 connecting, 1 connected, 2 failed or timed out: whichever
+             happens first owns the reserved slot */
+
+          ptr_t<uchar> flag = new uchar(0); ulong stamp = process::now();
+          function_t<void,T> cb = [=]( T cli ){
+               if( *flag != 0 ){ cli.close(); return; } *flag = 1; exchange( call, cli );
+          };
+
+          connect( call, cb, [=](){ if( *flag != 0 ){ return; } *flag = 2; pool->drop( call->key ); call->onEnd( 502 ); } );
+
+          process::poll::add([=](){ if( *flag != 0 ){ return -1; }
+               if( process::now()-stamp < pool->deadline ){ return 1; }
+               *flag = 2; pool->drop( call->key ); call->onEnd( 504 ); return -1;
+          });
+     }
+
+     void fetch( ptr_t<call_t> call ) noexcept {
+          if( !call->parse() ){ call->onEnd( 400 ); return; }
+          if( call->tls ){ open<https_t>( call ); } else { open<http_t>( call ); }
+     }
+
+}}
+#endif
+
+/*────────────────────────────────────────────────────────────────────────────*/
+
 #ifndef NODEPP_EXPRESS_GENERATOR
 #define NODEPP_EXPRESS_GENERATOR
+#ifndef NODEPP_EXPRESS_SSR_LIMIT
+#define NODEPP_EXPRESS_SSR_LIMIT 8
+#endif
+
+#ifndef NODEPP_EXPRESS_SSR_DEPTH
+#define NODEPP_EXPRESS_SSR_DEPTH 8
+#endif
 namespace nodepp { namespace _express_ { 
 
+     /* a template is kept as the literal text around each <° include °>,
+        text[x] goes before dir[x] and the last text closes the page; age
+        and stale hold the include cache directive, FRAGMENT_NONE falls
+        back to the fragment cache defaults */
+
+     const ulong FRAGMENT_NONE = (ulong) -1;
+
+     struct template_t { array_t<string_t> text, dir; array_t<ulong> age, stale; ulong size=0, mtime=0; };
+
+     /* <° target max-age=60 stale-while-revalidate=30 °> caches the output
+        of that include, no-store keeps it out of the cache */
+
+     void directive( string_t opt, ulong& age, ulong& stale ) noexcept {
+          age = stale = FRAGMENT_NONE;
+          if( opt.empty() ){ return; }
+          if( regex::test( opt, "no-store|no-cache", true ) ){ age = 0; return; }
+          auto item = regex::match( opt, "max-age=[0-9]+", true );
+          if( !item.empty() ){ age = string::to_ulong( item.slice( 8 ) ); }
+               item = regex::match( opt, "stale-while-revalidate=[0-9]+", true );
+          if( !item.empty() ){ stale = string::to_ulong( item.slice( 23 ) ); }
+     }
+
+     ptr_t<cache_t<template_t>> views() noexcept {
+          static ptr_t<cache_t<template_t>> pool = new cache_t<template_t>( 256 ); return pool;
+     }
+
+     /* ° is the two byte sequence C2 B0, so a tag is found by memchr on
+        '<' and then on the lead byte of the closing °>; [begin,end) is the
+        whole <°...°> and [first,last) its target, nothing is allocated */
+
+     struct mark_t { ulong begin=0, end=0, first=0, last=0; };
+
+     bool is_blank( char c ) noexcept { return c==' ' || c=='\n' || c=='\t' || c=='<' || c=='>'; }
+
+     bool scan( const char* raw, ulong size, ulong pos, mark_t& tag ) noexcept {
+          while( pos + 7 <= size ){
+               auto a = (const char*) memchr( raw+pos, '<', size-pos-6 ); if( a == nullptr ){ return false; }
+               ulong b = a - raw; pos = b + 1; if( (uchar)raw[b+1]!=0xC2 || (uchar)raw[b+2]!=0xB0 ){ continue; }
+
+               ulong c = b + 3; while( true ){
+                    auto d = (const char*) memchr( raw+c, 0xC2, size-c ); if( d == nullptr ){ return false; }
+                    c = d - raw; if( c+1 < size && (uchar)raw[c+1]==0xB0 ){ break; } c++;
+               }
+
+               /* no opener before this ° can close elsewhere, retry from it */
+               if( c == b+3 || c+2 >= size || raw[c+2] != '>' ){ pos = c - 1; continue; }
+
+               tag.begin = b; tag.end = c + 3; tag.first = b + 3;
+               while( tag.first < c && is_blank( raw[tag.first] ) ){ tag.first++; } tag.last = tag.first;
+               while( tag.last  < c && !is_blank( raw[tag.last] ) ){ tag.last++;  } return true;
+          }    return false;
+     }
+
+     ptr_t<template_t> parse( string_t raw ) noexcept {
+          ptr_t<template_t> out = new template_t(); ulong pos = 0; mark_t tag;
+          while( scan( raw.get(), raw.size(), pos, tag ) ){ ulong age, stale;
+               directive( raw.slice( tag.last, tag.end-3 ), age, stale );
+               out->text.push( raw.slice( pos, tag.begin ) ); out->dir.push( raw.slice( tag.first, tag.last ) );
+               out->age .push( age ); out->stale.push( stale ); pos = tag.end;
+          }    out->text.push( raw.slice( pos ) ); return out;
+     }
+
+     /* file templates are parsed once and served from the cache for as
+        long as their size and mtime match, reload() drops them early */
+
+     ptr_t<template_t> view( string_t path ) noexcept {
+          ulong size=0, mtime=0; string_t base; auto pool = views();
+          if( !stat_file( path, size, mtime ) ){ return ptr_t<template_t>(); }
+          auto item = pool->get( 0, base, path );
+          if( !item.null() && item->size==size && item->mtime==mtime ){ return item; }
+          if( !item.null() ){ pool->erase( 0, base, path ); } /* a stale hit keeps its slot otherwise */
+          auto file = fs::readable( path ); item = parse( stream::await( file ) );
+          item->size = size; item->mtime = mtime; pool->set( 0, base, path, item ); return item;
+     }
+
+     void reload( string_t path ) noexcept { string_t base;
+          if( path.empty() ){ views()->clear(); } else { views()->erase( 0, base, path ); }
+     }
+
+     /*.........................................................................*/
+
+     /* rendered includes are kept by target for their max-age, then served
+        stale for up to stale-while-revalidate seconds while one refresh
+        runs; like static assets the pool only grows up to `limit` bytes */
+
+     struct fragment_t { string_t data; ulong stamp=0; bool busy=false; };
+
+     class fragments_t {
+     public:
+
+          cache_t<fragment_t> cache = cache_t<fragment_t>( 1024 );
+          ulong used=0, limit=CHUNK_MB(8), age=0, stale=0;
+
+          ptr_t<fragment_t> get( string_t key ) noexcept { string_t base; return cache.get( 0, base, key ); }
+
+          void set( string_t key, string_t data, bool ok, ptr_t<fragment_t> prev ) noexcept {
+               if( !prev.null() ){ prev->busy = false; } if( !ok ){ return; } string_t base;
+               auto old = cache.erase( 0, base, key ); if( !old.null() ){ used -= old->data.size(); }
+               if( used + data.size() > limit ){ return; }
+               ptr_t<fragment_t> item = new fragment_t(); item->data = data; item->stamp = process::now();
+               old = cache.set( 0, base, key, item ); used += data.size();
+               if( !old.null() ){ used -= old->data.size(); }
+          }
+
+          void clear() noexcept { cache.clear(); used = 0; }
+
+     };
+
+     ptr_t<fragments_t> fragments() noexcept {
+          static ptr_t<fragments_t> pool = new fragments_t(); return pool;
+     }
+
+     /* a <° route:/path °> include runs the page's own router in process:
+        the handler answers into a capture instead of a socket, only the
+        body reaches onData and the head is kept as a status code, 404 if
+        the chain ran out before anything answered */
+
+     struct capture_t { function_t<void,string_t> onData; uint status=200; bool head=false, done=false; };
+
+     /* a router hands every request the same depth 0 local_t, a deeper one
+        is only made when a route: include is actually rendered; `owner`
+        points at the router without keeping it alive, the router clears
+        it when it goes away */
+
+     struct local_t {
+          void ( *run )( const void*, string_t, query_t, ptr_t<capture_t>, ptr_t<local_t> ) = nullptr;
+          ptr_t<const void*> owner; ulong depth=0;
+     };
+
+     /* every include of a page renders into its own slot, the page then
+        copies the slots out in document order as each one completes; a
+        slot that feeds the fragment cache also keeps a copy ( tee ) and a
+        background refresh is never read by the page ( quiet ) */
+
+     struct slot_t {
+          array_t<string_t> data; ptr_t<collect_t> copy; ptr_t<fragment_t> prev;
+          string_t key; bool done=false, tee=false, quiet=false;
+     };
+
+     class sink_t {
+     public: ptr_t<slot_t> slot; query_t params; ptr_t<local_t> local;
+
+          sink_t( ptr_t<slot_t> slot, query_t params, ptr_t<local_t> local ) noexcept
+          : slot( slot ), params( params ), local( local ) {}
+
+          ulong write( string_t data ) const noexcept { if( data.empty() ){ return 0; }
+               if( !slot->quiet ){ slot->data.push( data ); }
+               if(  slot->tee   ){ slot->copy->push( data ); } return data.size();
+          }
+
+          void finish( bool ok=true ) const noexcept { slot->done = true;
+               if( slot->tee ){ fragments()->set( slot->key, slot->copy->get(), ok, slot->prev ); }
+          }
+
+     };
 
      GENERATOR( ssr ) {
      protected:
 
           ptr_t<bool> state = new bool(0);
-          array_t<ptr_t<ulong>> match;
-          string_t      raw, dir;
-          ulong         pos, sop;
-          _file_::write gen;
-          ptr_t<ulong>  reg;
-          ptr_t<ssr>    cb;
+          ptr_t<uint> code  = new uint(0);
+          ptr_t<capture_t> cap;
+          array_t<ptr_t<slot_t>> list;
+          ptr_t<template_t> tpl;
+          ulong         sop, top;
+
+          /* keeps up to NODEPP_EXPRESS_SSR_LIMIT includes in flight past
+             the one being flushed, each on its own poll task */
+
+          template< class T >
+          void launch( ptr_t<slot_t> slot, T& str, string_t dir ) const noexcept {
+               ptr_t<sink_t> out = new sink_t( slot, str.params, str.local ); ptr_t<ssr> gen = new ssr();
+               process::poll::add([=](){
+                    if( (*gen)( *out, dir )==1 ){ return 1; } out->finish( *gen->code == 0 ); return -1;
+               });
+          }
+
+          /* answers the include from the fragment cache when it can, a stale
+             hit also starts the single refresh for that target; includes get
+             the page's params so those are part of the key too */
+
+          template< class T >
+          bool cached( ptr_t<slot_t> slot, ulong x, T& str ) const noexcept {
+               auto pool = fragments(); ulong age = tpl->age[x], stale = tpl->stale[x];
+               if( age   == FRAGMENT_NONE ){ age   = pool->age;   }
+               if( stale == FRAGMENT_NONE ){ stale = pool->stale; }
+               if( age == 0 ){ return false; } slot->key = tpl->dir[x] + "\n" + query::format( str.params );
+               auto item = pool->get( slot->key ); slot->tee = true; slot->copy = new collect_t( 0 );
+
+               if( item.null() ){ return false; } ulong time = process::now() - item->stamp;
+               if( time >= ( age+stale )*1000 ){ return false; }
+               slot->data.push( item->data ); slot->done = true; slot->tee = false;
+               if( time < age*1000 || item->busy ){ return true; } item->busy = true;
+
+               ptr_t<slot_t> bg = new slot_t(); bg->key = slot->key; bg->prev = item;
+               bg->tee = bg->quiet = true; bg->copy = new collect_t( 0 );
+               launch( bg, str, tpl->dir[x] ); return true;
+          }
+
+          template< class T >
+          void spawn( T& str ) noexcept {
+               while( top < tpl->dir.size() && top-sop < NODEPP_EXPRESS_SSR_LIMIT ){
+                    ptr_t<slot_t> slot = new slot_t(); list.push( slot ); ulong x = top++;
+                    if( !cached( slot, x, str ) ){ launch( slot, str, tpl->dir[x] ); }
+               }
+          }
+
+          template< class T >
+          bool drain( T& str ) noexcept { auto slot = list[sop];
+               for( ulong x=0; x<slot->data.size(); x++ ){ str.write( slot->data[x] ); }
+               slot->data = array_t<string_t>(); return slot->done;
+          }
 
      public:
 
@@ -56,94 +1736,52 @@ namespace nodepp { namespace _express_ {
           coEmit( T& str, string_t path ){
           gnStart
 
-               if( !url::is_valid( path ) ){
-               if( !fs::exists_file(path) ){ coGoto(1); }
-                    
-                    do{ auto file = fs::readable(path);
-                              raw = stream::await(file);
-                              gen = _file_::write(); pos=0; sop=0;
-                            match = regex::search_all(raw,"<°[^°]+°>");
-                    } while(0); while( sop != match.size() ){ 
-                         
-                         reg = match[sop]; cb = new ssr(); do {
-                         auto war = raw.slice( reg[0], reg[1] );
-                              dir = regex::match( war,"[^<°> \n\t]+" );
-                         } while(0);
+               if( regex::test( path, "^route:" ) ){ do { cap = new capture_t();
+                    if( str.local.null() || str.local->depth >= NODEPP_EXPRESS_SSR_DEPTH )
+                      { cap->status = 508; cap->done = true; break; }
+                    ptr_t<local_t> next = new local_t( *str.local ); next->depth++;
+                    cap->onData = [=]( string_t data ){ str.write( data ); };
+                    str.local->run( *str.local->owner, path.slice( 6 ), str.params, cap, next );
+               } while(0); while( !cap->done ){ coNext; } if( cap->status >= 400 ){ *code = cap->status; } }
+
+               elif( !url::is_valid( path ) || ( url::protocol(path)!="http" && url::protocol(path)!="https" ) ){
+
+                    if( !url::is_valid( path ) && fs::exists_file( path ) ){ tpl = view( path ); }
+                    if( tpl.null() ){ tpl = parse( path ); }
+
+                    for( sop=0, top=0; sop<tpl->dir.size(); sop++ ){ str.write( tpl->text[sop] );
+                         while( spawn( str ), !drain( str ) ){ coNext; }
+                    }    str.write( tpl->text[sop] );
+
+               } else { do {
+                    auto self = type::bind( this ); *state=1;
+                    ptr_t<call_t> call = new call_t(); call->url = path;
+                    call->headers = header_t({
+                         { "Params", query::format( str.params ) },
+                         { "User-Agent", "Nodepp Fetch" }
+                    });
+                    call->onHead = [=]( reply_t& rep ){ if( rep.status >= 400 ){ *self->code = rep.status; } };
+                    call->onData = [=]( string_t data ){ str.write( data ); };
+                    call->onEnd  = [=]( uint c ){ if( c != 0 ){ *self->code = c; } *self->state=0; };
+                    fetch( call );
+               } while(0); while( *state==1 ){ coNext; } }
 
-                         while( gen( &str, raw.slice( pos, reg[0] ) )==1 )
-                              { coNext; } pos = match[sop][1]; sop++;
-
-                         while( (*cb)( str, dir )==1 ){ coNext; }
-
-                    } while( gen( &str, raw.slice( pos ) )==1 ){ coNext; }
+          gnStop
+          }
 
-               } else {
+     };
 
-                    if( url::protocol(path)=="http" ){ do {
-                         auto self = type::bind( this );
-                         fetch_t args; *state=1;
-
-                         args.url     = path;
-                         args.method  = "GET";
-                         args.headers = header_t({
-                              { "Params", query::format( str.params ) },
-                              { "User-Agent", "Nodepp Fetch" },
-                              { "Host", url::hostname(path) }
-                         });
-
-                         http::fetch( args )
-                         .fail([=](...){ *self->state=0; }).then([=]( http_t cli ){
-                              cli.onData([=]( string_t data ){ str.write(data); });
-                              cli.onDrain.once([=](){ *self->state=0; });
-                              stream::pipe( cli );
-                         });
-
-                    } while(0); while( *state==1 ){ coNext; } }
-
-                    elif( url::protocol(path)=="https" ){ do {
-                         ssl_t ssl; fetch_t args; *state=1;
-                         auto self = type::bind( this );
-
-                         args.url     = path;
-                         args.method  = "GET";
-                         args.headers = header_t({
-                              { "Params", query::format( str.params ) },
-                              { "User-Agent", "Nodepp Fetch" },
-                              { "Host", url::hostname(path) }
-                         });
-
-                         https::fetch( args, &ssl )
-                         .fail([=](...){ *self->state=0; }).then([=]( https_t cli ){
-                              cli.onData([=]( string_t data ){ str.write(data); });
-                              cli.onDrain.once([=](){ *self->state=0; });
-                              stream::pipe( cli );
-                         });
-
-                    } while(0); while( *state==1 ){ coNext; } }
-
-                    else { coYield(1);
-                    
-                         do{  raw = path;
-                              gen = _file_::write(); pos=0; sop=0;
-                            match = regex::search_all(raw,"<°[^°]+°>");
-                         } while(0); while( sop != match.size() ){ 
-                              
-                              reg = match[sop]; cb = new ssr(); do {
-                              auto war = raw.slice( reg[0], reg[1] );
-                                   dir = regex::match( war,"[^<°> \n\t]+" );
-                              } while(0);
-
-                              while( gen( &str, raw.slice( pos, reg[0] ) )==1 )
-                                   { coNext; } pos = match[sop][1]; sop++;
-
-                              while( (*cb)( str, dir )==1 ){ coNext; }
-
-                         } while( gen( &str, raw.slice( pos ) )==1 ){ coNext; }
+     GENERATOR( render ) {
+     protected:
 
-                    }
+          ssr cb;
 
-               }
+     public:
 
+          template< class T >
+          coEmit( T& str, string_t path ){
+          gnStart
+               while( cb( str, path )==1 ){ coNext; } str.finish();
           gnStop
           }
 
@@ -154,7 +1792,7 @@ namespace nodepp { namespace _express_ {
 
 /*────────────────────────────────────────────────────────────────────────────*/
 
-namespace nodepp { class express_http_t : public http_t { 
+namespace nodepp { class express_http_t : public http_t {
 protected:
 
     struct NODE {
@@ -162,127 +1800,395 @@ protected:
         cookie_t _cookies;
         uint  status= 200;
         int    state= 1;
+        bool chunked= false;
+        bool    keep= false;
+        ulong    seq= 0;
+        ptr_t<_express_::pipeline_t> pipe;
+        string_t type; bool encoded=false, parsed=false;
+        ptr_t<_express_::compress_t> zip;
+        ptr_t<_express_::zstream_t>  z;
+        _express_::accept_t accept;
+        ptr_t<_express_::body_t> body;
+        ptr_t<_express_::capture_t> cap;
+        ulong unread= 0;
     };  ptr_t<NODE> exp;
 
-public: query_t params;
+     _express_::accept_t& accepted() const noexcept {
+          if( exp->parsed ){ return exp->accept; } exp->parsed = true;
+          exp->accept = _express_::accept( headers["Accept-Encoding"] );
+          return exp->accept;
+     }
+
+     /* picks the body encoding from the router policy, a compressible
+        body gets Vary and, if the client accepts one, a compressor */
+
+     uchar negotiate( ulong size ) const noexcept { auto zip = exp->zip;
+          if( exp->encoded || zip.null() || zip->level <= 0 ){ return _express_::ENCODING_IDENTITY; }
+          if( size < zip->min || !regex::test( exp->type, zip->mime, true ) ){ return _express_::ENCODING_IDENTITY; }
+          header( "Vary", "Accept-Encoding" ); auto enc = _express_::best( accepted() );
+          if( enc == _express_::ENCODING_IDENTITY ){ return enc; }
+          header( "Content-Encoding", _express_::coding( enc ) );
+          exp->z = new _express_::zstream_t( enc, zip->level ); return enc;
+     }
+
+     /* the body is copied so the worker owns its input, the head is
+        only written once the compressed length is known; a full queue
+        returns false and the body is compressed inline instead */
+
+     bool defer( string_t msg ) const noexcept {
+          ptr_t<_express_::job_t> job = new _express_::job_t(); auto self = *this;
+          job->z = *exp->z; job->in = string_t( msg.get(), msg.size() );
+          if( !exp->zip->pool->push( job.get() ) ){ return false; }
+          exp->z = ptr_t<_express_::zstream_t>(); exp->state = 0;
+
+          function_t<void,string_t> cb = [=]( string_t out ){
+               self.exp->_headers["Content-Length"] = string::to_string( out.size() );
+               self.commit( out ); self.finish();
+          };
+
+          auto task = _express_::offload(); process::poll::add( task, exp->zip->pool, job, cb ); return true;
+     }
+
+     template< class T >
+     void pump( T& src ) const noexcept { auto self = *this;
+          if( is_queued() ){ ptr_t<T> hold = new T( src ); at_front([=](){ self.pump( *hold ); }); return; }
+          src.onData([=]( string_t data ){ self.write( data ); });
+          src.onDrain.once([=](){ self.finish(); }); stream::pipe( src );
+     }
+
+     void frame( string_t data ) const noexcept {
+          if( data.empty() ){ return; } if( !exp->chunked ){ deliver( data ); return; }
+          deliver( string::format( "%lx\r\n", data.size() ) + data + "\r\n" );
+     }
+
+     bool is_front() const noexcept {
+          return exp->cap.null() && ( exp->pipe.null() || exp->pipe->head == exp->seq );
+     }
+
+     /* a response queued behind others only keeps its head in the slot, a
+        streamed body is started once every response before it finished so
+        a large file is never read ahead into memory */
+
+     bool is_queued() const noexcept { return exp->cap.null() && !is_front(); }
+
+     void at_front( function_t<void> cb ) const noexcept { auto self = *this;
+          process::poll::add([=](){
+               if( self.exp->pipe->stop || !self.is_available() ){ return -1; }
+               if( !self.is_front() ){ return 1; } cb(); return -1;
+          });
+     }
+
+     void deliver( string_t data ) const noexcept {
+          if( !exp->cap.null() ){ exp->cap->onData( data ); return; }
+          if( is_front() ){ http_t::write( data ); return; }
+          (*exp->pipe)[ exp->seq ].data.push( data );
+     }
+
+     void flush() const noexcept { auto pipe = exp->pipe;
+          while( pipe->busy() ){ auto& item = (*pipe)[ pipe->head ];
+               for( ulong x=0; x<item.data.size(); x++ ){ http_t::write( item.data[x] ); }
+               item.data = array_t<string_t>(); if( !item.done ){ return; }
+               if( item.close ){ pipe->stop = true; close(); return; } pipe->head++;
+          }    if( pipe->stop ){ close(); }
+     }
+
+     /* the head and a body go out as one write ( one TLS record ),
+        large plain bodies are gathered with writev instead of copied */
+
+     void commit( string_t body ) const noexcept {
+          if( exp->keep && exp->unread > 0 ){ close_delimited(); } if( exp->encoded ){ _express_::coded_etag( exp->_headers ); }
+          auto head = _express_::head( exp->status, exp->_headers ); exp->state = 0;
+          if( !exp->cap.null() ){ exp->cap->status = exp->status; exp->cap->head = true; if( method != "HEAD" ){ frame( body ); } return; }
+          if( body.empty() || method == "HEAD" ){ deliver( head ); return; }
+     #if !defined(_WIN32)
+          if( is_front() && body.size() > UNBFF_SIZE ){
+               ulong c = _express_::writev( *this, head, body );
+                 if( c < head.size() ){ http_t::write( head.slice( c ) ); http_t::write( body ); }
+               elif( c < head.size()+body.size() ){ http_t::write( body.slice( c-head.size() ) ); }
+               return;
+          }
+     #endif
+          deliver( head + body );
+     }
+
+     template< class T >
+     void transfer( T& file, ulong begin, ulong end ) const noexcept {
+          if( method == "HEAD" ){ finish(); return; } auto self = *this;
+          if( is_queued() ){ ptr_t<T> hold = new T( file ); at_front([=](){ self.transfer( *hold, begin, end ); }); return; }
+     #if defined(__linux__)
+          if( is_front() ){ auto cb = _express_::sendfile(); process::poll::add( cb, *this, file, begin, end ); return; }
+     #endif
+          file.set_range( begin, end ); pump( file );
+     }
+
+     void chunked() const noexcept {
+          if( !exp->keep ){ return; } if( protocol != "HTTP/1.1" ){ close_delimited(); return; }
+          header( "Transfer-Encoding", "chunked" ); exp->chunked = true;
+     }
+
+     void close_delimited() const noexcept {
+          exp->keep = false; header( "Connection", "close" );
+     }
+
+public: query_t params; ptr_t<_express_::local_t> local;
+
+     express_http_t ( http_t& cli ) noexcept : http_t( cli ), exp( new NODE() ) { exp->state = 1;
+          if( !headers["Content-Length"].empty() ){ exp->unread = string::to_ulong( headers["Content-Length"] ); }
+     }
+
+     /* an in-memory GET for route: includes, nothing here touches a socket */
 
-     express_http_t ( http_t& cli ) noexcept : http_t( cli ), exp( new NODE() ) { exp->state = 1; }
+     express_http_t ( string_t path, query_t params, ptr_t<_express_::capture_t> cap ) noexcept
+     : exp( new NODE() ), params( params ) { exp->state = 1; exp->cap = cap;
+          method = "GET"; protocol = "HTTP/1.1"; this->path = path;
+     }
 
-    ~express_http_t () noexcept { if( exp.count() > 1 ){ return; } close(); exp->state = 0; }
+    ~express_http_t () noexcept { if( exp.count() > 1 || exp->state < 0 ){ return; } 
+          if( !exp->cap.null() ){ exp->cap->done = true; exp->state = 0; return; }
+          if( exp->pipe.null() ){ close(); exp->state = 0; return; } exp->keep = false; finish();
+     }
 
      express_http_t () noexcept : exp( new NODE() ) { exp->state = 0; } 
 
     /*.........................................................................*/
 
+    bool is_available() const noexcept { return !exp->cap.null() || http_t::is_available(); }
+
     bool is_express_available() const noexcept { return exp->state >  0; }
 
     bool is_express_closed()    const noexcept { return exp->state <= 0; }
 
+    /*.........................................................................*/
+
+     const express_http_t& attach( ptr_t<_express_::pipeline_t> pipe, bool keep, ptr_t<_express_::compress_t> zip ) const noexcept {
+          exp->pipe = pipe; exp->seq = pipe->push(); exp->keep = keep; exp->zip = zip; return (*this);
+     }
+
+     bool accepts( string_t coding ) const noexcept {
+          auto type = _express_::encoding( coding ); if( type == _express_::ENCODING_SIZE ){ return false; }
+          return accepted().q[type] > 0;
+     }
+
+     ulong get_unread() const noexcept { return exp->unread; }
+
+     _express_::body_t& body() const noexcept {
+          if( exp->body.null() ){ exp->body = new _express_::body_t(); } return *exp->body;
+     }
+
+     /* streams the request body into `cb` ( a non zero return aborts with
+        that status ), then calls `done` with 0 or the status to answer */
+
+     const express_http_t& readBody( ulong limit, function_t<uint,string_t> cb, function_t<void,uint> done ) const noexcept {
+          return readBody( limit, cb, done, [](){ return 0; } );
+     }
+
+     /* `wait` is asked before every read: 1 leaves the socket alone for
+        now, -1 gives up with a 500, so a slow consumer throttles the peer;
+        bytes the head parser already buffered are consumed first and a peer
+        silent for NODEPP_EXPRESS_BODY_TIMEOUT ms is answered with 408 */
+
+     const express_http_t& readBody( ulong limit, function_t<uint,string_t> cb, function_t<void,uint> done, function_t<int> wait ) const noexcept {
+          ptr_t<_express_::inflow_t> flow = new _express_::inflow_t(); auto self = *this;
+          flow->chunked = regex::test( headers["Transfer-Encoding"], "chunked", true );
+          flow->remain  = exp->unread; flow->limit = limit;
+
+          if( !flow->chunked && flow->remain == 0 ){ done( 0 ); return (*this); }
+          if( !flow->chunked && flow->remain > limit ){ done( 413 ); return (*this); }
+          if( exp->state > 0 && is_front() && regex::test( headers["Expect"], "^100-continue$", true ) )
+            { http_t::write( "HTTP/1.1 100 Continue\r\n\r\n" ); }
+
+          flow->stamp = process::now(); process::poll::add([=](){ uint code = 0; int w = wait();
+               if( w > 0 ){ flow->stamp = process::now(); return 1; } if( w < 0 ){ done( 500 ); return -1; }
+               ulong size = flow->chunked ? CHUNK_KB(16) : min( flow->remain, (ulong) CHUNK_KB(16) ); int c;
+
+               auto bor = self.get_borrow(); if( !bor.empty() ){
+                    c = min( bor.size(), size ); memcpy( flow->bf.get(), bor.get(), c );
+                    self.set_borrow( bor.slice( c ) );
+               } else { c = self._read_( flow->bf.get(), size ); }
+
+               if( c == -2 ){
+                   if( process::now() - flow->stamp < NODEPP_EXPRESS_BODY_TIMEOUT ){ return 1; }
+                   done( 408 ); return -1;
+               }   if( c <= 0 ){ done( 400 ); return -1; } flow->stamp = process::now();
+
+               if( flow->chunked ){ int r = flow->decode( flow->bf.get(), c, cb, code );
+                   if( r < 0 ){ done( code ); return -1; } if( r == 0 ){ done( 0 ); return -1; }
+                   return 1;
+               }
+
+               flow->remain -= c; self.exp->unread -= c;
+               if( (code=cb( string_t( flow->bf.get(), c ) )) != 0 ){ done( code ); return -1; }
+               if( flow->remain > 0 ){ return 1; } done( 0 ); return -1;
+          }); return (*this);
+     }
+
+     ulong write( string_t data ) const noexcept {
+          if( data.empty() || method == "HEAD" ){ return 0; }
+          frame( exp->z.null() ? data : exp->z->update( data ) );
+          return data.size();
+     }
+
+     void finish() const noexcept {
+          if( exp->state < 0 ){ return; } exp->state = -1;
+          if( !exp->z.null() && method != "HEAD" ){ frame( exp->z->end() ); }
+          if( exp->chunked && method != "HEAD" ){ deliver( "0\r\n\r\n" ); }
+          if( !exp->cap.null() ){ exp->cap->done = true; return; }
+          if( exp->pipe.null() ){ close(); return; } auto pipe = exp->pipe;
+          auto& item = (*pipe)[ exp->seq ]; item.done = true; item.close = !exp->keep;
+          if( pipe->wait == exp->seq+1 ){ pipe->wait = 0; }
+          if( is_front() ){ flush(); }
+     }
+
     /*.........................................................................*/
 
      const express_http_t& send( string_t msg ) const noexcept { 
-          if( exp->state == 0 ){ return (*this); }
+          if( exp->state <= 0 ){ return (*this); }
+          if( negotiate( msg.size() ) != _express_::ENCODING_IDENTITY ){
+          if( !exp->zip->pool.null() && msg.size() >= exp->zip->offload && defer( msg ) ){ return (*this); }
+              msg = exp->z->end( msg ); exp->z = ptr_t<_express_::zstream_t>();
+          }   header( "Content-Length", string::to_string(msg.size()) );
+              commit( msg ); finish(); return (*this); 
+     }
+
+     const express_http_t& sendRaw( string_t msg ) const noexcept {
+          if( exp->state <= 0 ){ return (*this); }
           header( "Content-Length", string::to_string(msg.size()) );
-          if( regex::test( headers["Accept-Encoding"], "gzip" ) && msg.size()>UNBFF_SIZE ){
-              header( "Content-Encoding", "gzip" ); send();
-              write( zlib::gzip::get( msg ) ); close();
-          } else {
-              send(); write( msg ); close();
-          }   exp->state =0; return (*this); 
+          commit( msg ); finish(); return (*this);
      }
 
      const express_http_t& sendFile( string_t dir ) const noexcept {
-          if( exp->state == 0 ){ return (*this); } if( fs::exists_file( dir ) == false )
-            { status(404).send("file does not exist"); } file_t file ( dir, "r" );
-              header( "Content-Length", string::to_string(file.size()) );
-              header( "Content-Type", path::mimetype(dir) );
-          if( regex::test( headers["Accept-Encoding"], "gzip" ) ){
-              header( "Content-Encoding", "gzip" ); send();
-              zlib::gzip::pipe( file, *this );
-          } else {
-              send(); stream::pipe( file, *this );
-          }   exp->state = 0; return (*this);
+          if( exp->state <= 0 ){ return (*this); } if( fs::exists_file( dir ) == false )
+            { status(404).send("file does not exist"); return (*this); } 
+          header( "Content-Type", path::mimetype(dir) );
+          auto enc = _express_::sidecar( accepted(), dir ); file_t file ( dir+enc, "r" );
+          if( !enc.empty() ){ header( "Vary", "Accept-Encoding" );
+              header( "Content-Encoding", enc==".br" ? "br" : "gzip" );
+          } elif( negotiate( file.size() ) != _express_::ENCODING_IDENTITY ){
+              chunked(); send(); pump( file ); return (*this);
+          }   header( "Content-Length", string::to_string(file.size()) );
+              send(); transfer( file, 0, file.size() ); return (*this);
+     }
+
+     const express_http_t& sendRange( string_t dir, ulong begin, ulong end ) const noexcept {
+          if( exp->state <= 0 ){ return (*this); } if( fs::exists_file( dir ) == false )
+            { status(404).send("file does not exist"); return (*this); } file_t file ( dir, "r" );
+              header( "Content-Length", string::to_string( end-begin ) );
+              send(); transfer( file, begin, end ); return (*this);
+     }
+
+     const express_http_t& sendRanges( string_t dir, array_t<_express_::range_t> list, string_t type ) const noexcept {
+          ulong size=0, mtime=0; if( exp->state <= 0 ){ return (*this); } if( !_express_::stat_file( dir, size, mtime ) )
+            { status(404).send("file does not exist"); return (*this); }
+
+          auto bound = string::format( "%016lx", _express_::hash( dir.get(), dir.size() ) ^ process::now() );
+          array_t<string_t> part; ulong length = 0;
+
+          for( ulong x=0; x<list.size(); x++ ){
+               part.push( string::format( "%s--%s\r\nContent-Type: %s\r\nContent-Range: bytes %lu-%lu/%lu\r\n\r\n",
+                          x==0 ? "" : "\r\n", bound.get(), type.get(), list[x].begin, list[x].end-1, size ) );
+               length += part[x].size() + list[x].end - list[x].begin;
+          }    part.push( string::format( "\r\n--%s--\r\n", bound.get() ) ); length += part[ part.last() ].size();
+
+          header( "Content-Type", "multipart/byteranges; boundary=" + bound );
+          header( "Content-Length", string::to_string( length ) ); send();
+          if( method == "HEAD" ){ finish(); return (*this); }
+
+          auto cb = _express_::byteranges(); auto self = *this;
+          if( is_queued() ){ at_front([=](){ process::poll::add( cb, self, dir, list, part ); }); return (*this); }
+          process::poll::add( cb, *this, dir, list, part ); return (*this);
      }
 
      const express_http_t& sendJSON( object_t json ) const noexcept {
-          if( exp->state == 0 ){ return (*this); } auto data = json::stringify(json);
-          header( "content-length", string::to_string(data.size()) );
+          if( exp->state <= 0 ){ return (*this); } string_t data;
+          ptr_t<_express_::jsonify_t> body = new _express_::jsonify_t( json );
           header( "content-type", path::mimetype(".json") );
-          send( data ); exp->state = 0; return (*this);
+          if( !body->next( data, CHUNK_KB(16) ) ){ send( data ); return (*this); }
+
+          negotiate( (ulong)-1 ); chunked(); send(); write( data );
+          if( method == "HEAD" ){ finish(); return (*this); } auto self = *this;
+
+          process::poll::add([=](){ string_t data;
+               bool more = body->next( data, CHUNK_KB(16) ); self.write( data );
+               if( more ){ return 1; } self.finish(); return -1;
+          }); return (*this);
+     }
+
+     template< class T, class = typename std::enable_if<_express_::is_record<T>::value>::type >
+     const express_http_t& sendJSON( const T& value ) const noexcept {
+          if( exp->state <= 0 ){ return (*this); } _express_::writer_t out;
+          _express_::encode( out, value ); header( "content-type", path::mimetype(".json") );
+          send( out.get() ); return (*this);
      }
 
      const express_http_t& cache( ulong time ) const noexcept {
-          if( exp->state == 0 ){ return (*this); }
+          if( exp->state <= 0 ){ return (*this); }
           header( "Cache-Control",string::format( "public, max-age=%lu",time) );
           return (*this);
      }
 
      const express_http_t& cookie( string_t name, string_t value ) const noexcept {
-          if( exp->state == 0 ){ return (*this); } exp->_cookies[ name ] = value;
+          if( exp->state <= 0 ){ return (*this); } exp->_cookies[ name ] = value;
           header( "Set-Cookie", cookie::format( exp->_cookies ) );
           return (*this);
      }
 
      const express_http_t& header( string_t name, string_t value ) const noexcept {
-          if( exp->state == 0 )    { return (*this); }
+          if( exp->state <= 0 )    { return (*this); }
+            if( name.size()==12 && regex::test( name, "^content-type$",     true ) ){ exp->type = value;   }
+          elif( name.size()==16 && regex::test( name, "^content-encoding$", true ) ){ exp->encoded = true; }
           exp->_headers[name]=value; return (*this);
      }
 
      const express_http_t& redirect( uint value, string_t url ) const noexcept {
-          if( exp->state == 0 ){ return (*this); }
+          if( exp->state <= 0 ){ return (*this); }
           header( "location",url ); status( value ); 
-          send(); exp->state = 0; return (*this);
+          header( "Content-Length", "0" ); send(); finish(); return (*this);
      }
 
      template< class T >
      const express_http_t& sendStream( T readableStream ) const noexcept {
-          if( exp->state == 0 ){ return (*this); }
-          if( regex::test( headers["Accept-Encoding"], "gzip" ) ){
-              header( "Content-Encoding", "gzip" ); send();
-              zlib::gzip::pipe( readableStream, *this );
-          } else { send(); 
-              stream::pipe( readableStream, *this );
-          }   exp->state = 0; return (*this);
+          if( exp->state <= 0 ){ return (*this); }
+          negotiate( (ulong)-1 ); chunked(); send();
+          pump( readableStream ); return (*this);
      }
 
      const express_http_t& header( header_t headers ) const noexcept {
-          if( exp->state == 0 ){ return (*this); }
+          if( exp->state <= 0 ){ return (*this); }
           forEach( item, headers.data() ){
               header( item.first, item.second );
           }   return (*this);
      }
 
      const express_http_t& redirect( string_t url ) const noexcept {
-          if( exp->state == 0 ){ return (*this); }
+          if( exp->state <= 0 ){ return (*this); }
           return redirect( 302, url );
      }
 
      const express_http_t& render( string_t path ) const noexcept {
-          if( exp->state == 0 ){ return (*this); }
-		auto cb = _express_::ssr(); send();  
+          if( exp->state <= 0 ){ return (*this); }
+		auto cb = _express_::render(); negotiate( (ulong)-1 ); chunked(); send();  
           process::poll::add( cb, *this, path ); 
           return (*this);
      }
 
      const express_http_t& status( uint value ) const noexcept {
-          if( exp->state == 0 ){ return (*this); }
+          if( exp->state <= 0 ){ return (*this); }
               exp->status=value; return (*this);
      }
 
      const express_http_t& clear_cookies() const noexcept {
-          if( exp->state == 0 ){ return (*this); } 
+          if( exp->state <= 0 ){ return (*this); } 
           header( "Clear-Site-Data", "\"cookies\"" );
           return (*this);
      }
 
      const express_http_t& send() const noexcept {
-          if( exp->state == 0 ){ return (*this); }
-          write_header(exp->status,exp->_headers);
-          exp->state = 0; return (*this);
+          if( exp->state <= 0 ){ return (*this); }
+          commit( nullptr ); return (*this);
      }
 
      const express_http_t& done() const noexcept {
-          if( exp->state == 0 ){ return (*this); }
+          if( exp->state <= 0 ){ return (*this); }
           exp->state = 0; return (*this);
      }
 
@@ -294,67 +2200,262 @@ namespace nodepp { class express_tcp_t {
 protected:
 
      struct express_item_t {
-          optional_t<MIDDL> middleware;
-          optional_t<CALBK> callback;
-          optional_t<any_t> router;
-          string_t          method;
-          string_t          path;
+          optional_t<MIDDL>           middleware;
+          optional_t<CALBK>           callback;
+          optional_t<any_t>           router;
+          array_t<_express_::segment_t> list;
+          string_t                    method;
+          string_t                    path;
+          bool                        exact=false;
+          uchar                       verb =_express_::METHOD_ANY;
+     };
+
+     struct express_node_t {
+          array_t<ptr_t<express_node_t>> child;
+          ptr_t<express_node_t> param, glob;
+          array_t<ulong>        prefix[_express_::METHOD_SIZE],
+                                exact [_express_::METHOD_SIZE];
+          _express_::segment_t  key; ulong size=0;
+     };
+
+     /* a chain in progress: middlewares may call next() after returning,
+        the walk then resumes from the next item and `done` hands control
+        back to the parent router once the chain runs out */
+
+     struct express_step_t {
+          ptr_t<_express_::chain_t> chain;
+          _express_::request_t      req;
+          function_t<void>          done;
+          ulong x=0; bool busy=false, wait=false, flat=false;
      };
 
      struct NODE {
-          queue_t<express_item_t> list;
+          array_t<express_item_t>       list, table;
+          array_t<_express_::segment_t> mount;
+          ptr_t<express_node_t>   root = new express_node_t();
+          ptr_t<express_node_t>   flat;
+          ptr_t<_express_::cache_t<_express_::chain_t>> cache;
+          string_t base, parent; bool ready=false, frozen=false;
+          ulong    keep=100, idle=5000, depth=8;
+          ptr_t<_express_::compress_t> zip = new _express_::compress_t();
+          ptr_t<_express_::local_t>    local;
           agent_t* agent= nullptr;
           string_t path = nullptr;
           tcp_t    fd;
      };   ptr_t<NODE> obj;
 
-     void execute( string_t path, express_item_t& data, express_http_t& cli, function_t<void>& next ) const noexcept {
+     void execute( string_t path, express_item_t& data, express_http_t& cli, _express_::request_t& req, function_t<void>& next ) const noexcept {
             if( data.middleware.has_value() ){ data.middleware.value()( cli, next ); }
           elif( data.callback.has_value()   ){ data.callback.value()( cli ); next(); }
           elif( data.router.has_value()     ){ 
                 auto self = type::bind( data.router.value().as<express_tcp_t>() );
-                     self->run( path, cli ); next();
+                     self->run( path, cli, req, next );
           }
      }
 
-     bool path_match( express_http_t& cli, string_t base, string_t path ) const noexcept {
-          string_t pathname = normalize( base, path );
+     /*.........................................................................*/
 
-          array_t<string_t> _path[2] = {
-               string::split( cli.path, '/' ), 
-               string::split( pathname, '/' )
-          };
+     /* literal patterns and patterns ending in "*" match as a prefix, the
+        ones with ":param" must consume the whole path; indexes point into
+        the item table so sorting the matches restores registration order. */
+
+     void place( array_t<ptr_t<express_node_t>>& table, ptr_t<express_node_t> node ) const noexcept {
+          ulong size = table.size(); for( ulong x=0; x<size; x++ ){
+          auto& slot = table[ ( node->key.hash+x ) & ( size-1 ) ];
+          if  ( slot.null() ){ slot = node; return; }
+          }
+     }
 
-          if( regex::test( cli.path, "^"+pathname ) ){ return true;  }
-          if( _path[0].size() != _path[1].size() )   { return false; }
+     ptr_t<express_node_t> child( ptr_t<express_node_t> node, _express_::segment_t& seg ) const noexcept {
+          ulong size = node->child.size(); for( ulong x=0; x<size; x++ ){
+          auto& slot = node->child[ ( seg.hash+x ) & ( size-1 ) ]; if( slot.null() ){ break; }
+          if  ( slot->key.hash==seg.hash && slot->key.data==seg.data ){ return slot; }
+          }
 
-          for ( ulong x=0; x<_path[0].size(); x++ ){ if( _path[1][x]==nullptr ){ return false; }
-          elif( _path[1][x][0] == ':' ){ cli.params[_path[1][x].slice(1)]=url::normalize(_path[0][x]); }
-          elif( _path[1][x]    == "*"         ){ continue;     }
-          elif( _path[1][x]    == nullptr     ){ continue;     }
-          elif( _path[1][x]    != _path[0][x] ){ return false; }
+          if( ( node->size+1 )*2 > size ){
+               array_t<ptr_t<express_node_t>> table; size = size==0 ? 4 : size*2;
+               for( ulong x=0; x<size; x++ ){ table.push( ptr_t<express_node_t>() ); }
+               for( ulong x=0; x<node->child.size(); x++ ){
+               if ( !node->child[x].null() ){ place( table, node->child[x] ); }
+               }    node->child = table;
           }
 
-          return true;
+          ptr_t<express_node_t> out = new express_node_t(); out->key = seg;
+          place( node->child, out ); node->size++; return out;
      }
 
-     void run( string_t path, express_http_t& cli ) const noexcept {
+     ptr_t<express_node_t> find( ptr_t<express_node_t> node, string_t& path, _express_::token_t& tok ) const noexcept {
+          ulong size = node->child.size(); for( ulong x=0; x<size; x++ ){
+          auto& slot = node->child[ ( tok.hash+x ) & ( size-1 ) ]; if( slot.null() ){ break; }
+          if  ( _express_::equal( path, tok, slot->key ) ){ return slot; }
+          }    return ptr_t<express_node_t>();
+     }
+
+     void insert( ptr_t<express_node_t> node, array_t<express_item_t>& table, express_item_t& item ) const noexcept {
+          ulong end = item.list.size();
+          if( end>0 && item.list[end-1].type==_express_::SEGMENT_GLOB ){ end--; }
+
+          for( ulong x=0; x<end; x++ ){ auto& seg = item.list[x];
+            if( seg.type==_express_::SEGMENT_PARAM ){
+                if( node->param.null() ){ node->param = new express_node_t(); }
+                    node = node->param;
+          } elif( seg.type==_express_::SEGMENT_GLOB ){
+                if( node->glob.null()  ){ node->glob  = new express_node_t(); }
+                    node = node->glob;
+          } else {  node = child( node, seg ); }
+          }
+
+          if( item.exact ){ node->exact [item.verb].push( table.size() ); }
+          else            { node->prefix[item.verb].push( table.size() ); }
+          table.push( item );
+     }
+
+     void push( express_item_t item ) const {
+          if( obj->frozen ){ process::error("router is frozen, routes can't be added after compile()"); }
+          if( !obj->cache.null() ){ obj->cache->clear(); }
+          item.list = _express_::compile( item.path ); ulong end = item.list.size();
+          item.verb = _express_::method( item.method );
+
+          if( end==0 || item.list[end-1].type!=_express_::SEGMENT_GLOB ){
+          for( ulong x=0; x<end; x++ ){
+          if ( item.list[x].type!=_express_::SEGMENT_TEXT ){ item.exact=true; break; }
+          }}
+
+          insert( obj->root, obj->list, item );
+     }
 
-          auto n     = obj->list.first(); 
+     void flatten( string_t path, ptr_t<express_node_t> node, array_t<express_item_t>& table ) const noexcept {
           auto _base = normalize( path, obj->path );
-          function_t<void> next = [&](){ n = n->next; };
+          auto mount = _express_::compile( _base ); obj->frozen = true;
+          ulong end  = mount.size();
+          if( end>0 && mount[end-1].type==_express_::SEGMENT_GLOB ){ end--; }
+
+          for( ulong x=0; x<obj->list.size(); x++ ){ auto& item = obj->list[x];
+          if ( item.router.has_value() ){
+               auto self = type::bind( item.router.value().as<express_tcp_t>() );
+                    self->flatten( _base, node, table ); continue;
+          }    express_item_t out = item; out.list = array_t<_express_::segment_t>();
+               for( ulong y=0; y<end; y++ ){ out.list.push( mount[y] ); }
+               for( ulong y=0; y<item.list.size(); y++ ){ out.list.push( item.list[y] ); }
+               insert( node, table, out );
+          }
+     }
+
+     void walk( ptr_t<express_node_t> node, string_t& path, _express_::request_t& req, ulong x, array_t<ulong>& match ) const noexcept {
+          collect( node->prefix, req.method, match ); if( x==req.list.size() ){
+          collect( node->exact , req.method, match ); return; }
+          auto nxt = find( node, path, req.list[x] );
+          if ( !nxt.null() )        { walk( nxt        , path, req, x+1, match ); }
+          if ( !node->param.null() ){ walk( node->param, path, req, x+1, match ); }
+          if ( !node->glob .null() ){ walk( node->glob , path, req, x+1, match ); }
+     }
+
+     void collect( array_t<ulong>* bucket, uchar verb, array_t<ulong>& match ) const noexcept {
+          for( ulong y=0; y<bucket[0].size(); y++ ){ match.push( bucket[0][y] ); } if( !verb ){ return; }
+          for( ulong y=0; y<bucket[verb].size(); y++ ){ match.push( bucket[verb][y] ); }
+     }
+
+     bool path_match( string_t& path, _express_::request_t& req, ulong& off ) const noexcept {
+          auto& base = obj->mount; ulong end = base.size(); 
+          if( end>0 && base[end-1].type==_express_::SEGMENT_GLOB ){ end--; }
+          if( req.list.size() < end ){ return false; }
+
+          for ( ulong x=0; x<end; x++ ){ 
+            if( base[x].type != _express_::SEGMENT_TEXT ){ continue; }
+          elif( !_express_::equal( path, req.list[x], base[x] ) ){ return false; }
+          }
+
+          off = end; return true;
+     }
 
-          while( n!=nullptr ){
-               if( !cli.is_available() || cli.is_express_closed() ){ break; } 
-               if(( n->data.path == nullptr && regex::test( cli.path, "^"+_base )) 
-               || ( n->data.path == nullptr && obj->path == nullptr ) 
-               || ( path_match( cli, _base, n->data.path )) ){
-               if ( n->data.method==nullptr || n->data.method==cli.method ){ 
-                    execute( _base, n->data, cli, next ); 
-               } else { next(); }
-               } else { next(); }
+     void bind( _express_::chain_t& chain, express_http_t& cli, express_item_t& item, _express_::request_t& req, ulong off ) const noexcept {
+          for ( ulong x=0; x<item.list.size() && off+x<req.list.size(); x++ ){
+          if  ( item.list[x].type == _express_::SEGMENT_PARAM ){ auto& tok = req.list[off+x];
+                chain.key  .push( item.list[x].data );
+                chain.value.push( url::normalize( cli.path.slice( tok.pos, tok.pos+tok.size ) ) ); 
+          }}    chain.param.push( chain.key.size() );
+     }
+
+     ptr_t<_express_::chain_t> resolve( ptr_t<express_node_t> node, array_t<express_item_t>& table, express_http_t& cli, _express_::request_t& req, ulong off ) const noexcept {
+          ptr_t<_express_::chain_t> chain = new _express_::chain_t(); array_t<ulong> match;
+          walk( node, cli.path, req, off, match ); _express_::sort( match );
+
+          for( ulong x=0; x<match.size(); x++ ){ auto& item = table[ match[x] ];
+          if ( item.verb==_express_::METHOD_EXTEND && item.method!=cli.method ){ continue; }
+               chain->match.push( match[x] ); bind( *chain, cli, item, req, off );
+          }    return chain;
+     }
+
+     void dispatch( ptr_t<express_node_t> node, array_t<express_item_t>& table, express_http_t& cli, _express_::request_t& req, ulong off, function_t<void>& done ) const noexcept {
+
+          /* extension verbs share one method slot but filter by name, so
+             their chains are resolved every time instead of cached */
+
+          bool memo = !obj->cache.null() && req.method != _express_::METHOD_EXTEND;
+          ptr_t<_express_::chain_t> chain; if( memo ){
+                chain = obj->cache->get( req.method, obj->parent, cli.path );
+          }   if( chain.null() ){ chain = resolve( node, table, cli, req, off );
+          if  ( memo ){ obj->cache->set( req.method, obj->parent, cli.path, chain ); }}
+
+          ptr_t<express_step_t> step = new express_step_t(); step->chain = chain;
+          step->req = req; step->done = done; step->flat = &table == &obj->table;
+          resume( step, cli );
+
+     }
+
+     void resume( ptr_t<express_step_t> step, express_http_t cli ) const noexcept {
+          auto& table = step->flat ? obj->table : obj->list; auto chain = step->chain; auto self = *this;
+
+          function_t<void> next = [=](){ if( !step->wait ){ return; }
+               step->wait = false; step->x++; if( !step->busy ){ self.resume( step, cli ); }
+          };
+
+          step->busy = true; while( step->x<chain->match.size() ){ ulong x = step->x;
+               if( !cli.is_available() || cli.is_express_closed() ){ step->busy = false; return; }
+               for( ulong y=( x==0 ? 0 : chain->param[x-1] ); y<chain->param[x]; y++ )
+                  { cli.params[ chain->key[y] ] = chain->value[y]; }
+               step->wait = true; execute( obj->base, table[ chain->match[x] ], cli, step->req, next );
+               if( step->wait ){ step->busy = false; return; }
+          }    step->busy = false; step->done();
+     }
+
+     void run( string_t path, express_http_t& cli, _express_::request_t& req, function_t<void> done ) const noexcept {
+
+          if( !obj->flat.null() && path==nullptr ){ 
+               dispatch( obj->flat, obj->table, cli, req, 0, done ); return; 
+          }
+
+          if( !obj->ready || obj->parent != path ){
+               obj->base  = normalize( path, obj->path ); obj->parent = path;
+               obj->mount = _express_::compile( obj->base ); obj->ready = true;
           }
 
+          ulong off=0; if( !path_match( cli.path, req, off ) ){ done(); return; }
+          dispatch( obj->root, obj->list, cli, req, off, done );
+
+     }
+
+     /* route: includes of a page come back to the router that served it;
+        the hook is built once per router and only shared with requests,
+        it names the first copy that dispatched until that copy is gone */
+
+     static void serve( const void* owner, string_t path, query_t params, ptr_t<_express_::capture_t> cap, ptr_t<_express_::local_t> local ) noexcept {
+          if( owner == nullptr ){ cap->status = 503; cap->done = true; return; }
+          auto self = (const express_tcp_t*) owner; express_http_t res( path, params, cap ); res.local = local;
+          _express_::request_t req; req.method = _express_::method( res.method ); req.list = _express_::tokenize( res.path );
+          self->run( nullptr, res, req, [=](){ if( !cap->head ){ cap->status = 404; } } );
+     }
+
+     ptr_t<_express_::local_t> local() const noexcept {
+          if( obj->local.null() ){ obj->local = new _express_::local_t();
+              obj->local->owner = new const void*( nullptr ); obj->local->run = &serve;
+          }   if( *obj->local->owner == nullptr ){ *obj->local->owner = this; } return obj->local;
+     }
+
+     void run( string_t path, express_http_t& cli ) const noexcept {
+          if( cli.local.null() ){ cli.local = local(); }
+          _express_::request_t req; req.method = _express_::method( cli.method );
+          req.list = _express_::tokenize( cli.path ); run( path, cli, req, [](){} );
      }
 
      string_t normalize( string_t base, string_t path ) const noexcept {
@@ -362,13 +2463,32 @@ protected:
                                 ("/"+base) : path::join( base, path );
      }
 
+     void accept( http_t cli, ptr_t<_express_::pipeline_t> pipe ) const noexcept {
+          express_http_t res( cli ); if( res.headers["params"] ){
+              res.params = query::parse( res.headers["params"] ); 
+          }
+
+          bool keep = ++pipe->count < obj->keep && !pipe->stop && _express_::keep_alive( cli );
+          res.header( "Connection", keep ? "keep-alive" : "close" ).attach( pipe, keep, obj->zip );
+
+          if( keep ){ auto self = type::bind( this );
+              if( !_express_::idempotent( cli ) ){ pipe->wait = pipe->tail; }
+              function_t<void,http_t> cb = [=]( http_t cli ){ self->accept( cli, pipe ); };
+              auto task = _express_::idle(); process::poll::add( task, cli, obj->idle, pipe, cb );
+          }
+
+          run( nullptr, res );
+     }
+
 public:
 
     express_tcp_t( agent_t* agent ) noexcept : obj( new NODE() ){ obj->agent = agent; }
 
     express_tcp_t() noexcept : obj( new NODE() ) {}
 
-   ~express_tcp_t() noexcept {}
+   ~express_tcp_t() noexcept {
+         if( !obj->local.null() && *obj->local->owner == this ){ *obj->local->owner = nullptr; }
+    }
 
     /*.........................................................................*/
 
@@ -386,238 +2506,289 @@ public:
 
     /*.........................................................................*/
 
-    const express_tcp_t& USE( string_t _path, express_tcp_t cb ) const noexcept {
+    void run( express_http_t& cli ) const noexcept { run( nullptr, cli ); }
+
+    /*.........................................................................*/
+
+    bool is_frozen() const noexcept { return obj->frozen; }
+
+    const express_tcp_t& compile() const noexcept {
+         if( !obj->flat.null() ){ return (*this); }
+         ptr_t<express_node_t>   node = new express_node_t();
+         array_t<express_item_t> table; flatten( nullptr, node, table );
+         obj->table = table; obj->flat = node; 
+         if( !obj->cache.null() ){ obj->cache->clear(); } return (*this);
+    }
+
+    /*.........................................................................*/
+
+    const express_tcp_t& set_cache( ulong size ) const noexcept {
+         if( size==0 ){ obj->cache = ptr_t<_express_::cache_t<_express_::chain_t>>(); return (*this); }
+         obj->cache = new _express_::cache_t<_express_::chain_t>( size ); return (*this);
+    }
+
+    ulong get_cache_hits() const noexcept { return obj->cache.null() ? 0 : obj->cache->hit; }
+
+    ulong get_cache_misses() const noexcept { return obj->cache.null() ? 0 : obj->cache->miss; }
+
+    const express_tcp_t& set_keep_alive( ulong max, ulong timeout=5000 ) const noexcept {
+         obj->keep = max; obj->idle = timeout; return (*this);
+    }
+
+    const express_tcp_t& set_pipeline( ulong depth ) const noexcept {
+         obj->depth = depth; return (*this);
+    }
+
+    const express_tcp_t& set_compression( ulong min, int level=6, string_t mime=nullptr ) const noexcept {
+         ptr_t<_express_::compress_t> zip = new _express_::compress_t(); zip->min = min; zip->level = level;
+         if( !mime.empty() ){ zip->mime = mime; } zip->pool = obj->zip->pool;
+         zip->offload = obj->zip->offload; obj->zip = zip; return (*this);
+    }
+
+    /* a second call stops the previous workers, 0 threads disables it */
+
+    const express_tcp_t& set_offload( ulong threads, ulong queue=64, ulong min=CHUNK_KB(64) ) const noexcept {
+         if( !obj->zip->pool.null() ){ obj->zip->pool->stop(); } obj->zip->offload = min;
+         obj->zip->pool = ptr_t<_express_::offload_t>(); if( threads == 0 ){ return (*this); }
+         obj->zip->pool = new _express_::offload_t( threads, queue ); return (*this);
+    }
+
+    ulong get_offload_depth() const noexcept { return obj->zip->pool.null() ? 0 : obj->zip->pool->depth(); }
+
+    /*.........................................................................*/
+
+    const express_tcp_t& USE( string_t _path, express_tcp_t cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          cb.set_path( normalize( obj->path, _path ) );
          item.path       = nullptr;
          item.method     = nullptr;
          item.router     = optional_t<any_t>(cb);
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
-    const express_tcp_t& USE( express_tcp_t cb ) const noexcept {
+    const express_tcp_t& USE( express_tcp_t cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          cb.set_path( normalize( obj->path, nullptr ) );
          item.path       = nullptr;
          item.method     = nullptr;
          item.router     = optional_t<any_t>(cb);
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
     /*.........................................................................*/
 
-    const express_tcp_t& USE( string_t _path, MIDDL cb ) const noexcept {
+    const express_tcp_t& USE( string_t _path, MIDDL cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          item.middleware = optional_t<MIDDL>(cb);
          item.method     = nullptr;
          item.path       = _path;
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
-    const express_tcp_t& USE( MIDDL cb ) const noexcept {
+    const express_tcp_t& USE( MIDDL cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          item.middleware = optional_t<MIDDL>(cb);
          item.method     = nullptr;
          item.path       = nullptr;
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
     /*.........................................................................*/
 
-    const express_tcp_t& ALL( string_t _path, CALBK cb ) const noexcept {
+    const express_tcp_t& ALL( string_t _path, CALBK cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          item.method   = nullptr;
          item.path     = _path;
          item.callback = cb;
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
-    const express_tcp_t& ALL( CALBK cb ) const noexcept {
+    const express_tcp_t& ALL( CALBK cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          item.path     = nullptr;
          item.method   = nullptr;
          item.callback = cb;
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
     /*.........................................................................*/
 
-    const express_tcp_t& RAW( string_t _method, string_t _path, CALBK cb ) const noexcept {
+    const express_tcp_t& RAW( string_t _method, string_t _path, CALBK cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          item.method   = _method;
          item.path     = _path;
          item.callback = cb;
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
-    const express_tcp_t& RAW( string_t _method, CALBK cb ) const noexcept {
+    const express_tcp_t& RAW( string_t _method, CALBK cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          item.path     = nullptr;
          item.method   = _method;
          item.callback = cb;
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
     /*.........................................................................*/
 
-    const express_tcp_t& GET( string_t _path, CALBK cb ) const noexcept {
+    const express_tcp_t& GET( string_t _path, CALBK cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          item.method   = "GET";
          item.path     = _path;
          item.callback = cb;
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
-    const express_tcp_t& GET( CALBK cb ) const noexcept {
+    const express_tcp_t& GET( CALBK cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          item.path     = nullptr;
          item.method   = "GET";
          item.callback = cb;
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
     /*.........................................................................*/
 
-    const express_tcp_t& POST( string_t _path, CALBK cb ) const noexcept {
+    const express_tcp_t& POST( string_t _path, CALBK cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          item.method   = "POST";
          item.path     = _path;
          item.callback = cb;
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
-    const express_tcp_t& POST( CALBK cb ) const noexcept {
+    const express_tcp_t& POST( CALBK cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          item.path     = nullptr;
          item.method   = "POST";
          item.callback = cb;
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
     /*.........................................................................*/
 
-    const express_tcp_t& REMOVE( string_t _path, CALBK cb ) const noexcept {
+    const express_tcp_t& REMOVE( string_t _path, CALBK cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          item.method   = "DELETE";
          item.path     = _path;
          item.callback = cb;
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
-    const express_tcp_t& REMOVE( CALBK cb ) const noexcept {
+    const express_tcp_t& REMOVE( CALBK cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          item.method   = "DELETE";
          item.path     = nullptr;
          item.callback = cb;
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
     /*.........................................................................*/
 
-    const express_tcp_t& PUT( string_t _path, CALBK cb ) const noexcept {
+    const express_tcp_t& PUT( string_t _path, CALBK cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          item.method   = "PUT";
          item.path     = _path;
          item.callback = cb;
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
-    const express_tcp_t& PUT( CALBK cb ) const noexcept {
+    const express_tcp_t& PUT( CALBK cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          item.path     = nullptr;
          item.method   = "PUT";
          item.callback = cb;
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
     /*.........................................................................*/
 
-    const express_tcp_t& HEAD( string_t _path, CALBK cb ) const noexcept {
+    const express_tcp_t& HEAD( string_t _path, CALBK cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          item.method   = "HEAD";
          item.path     = _path;
          item.callback = cb;
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
-    const express_tcp_t& HEAD( CALBK cb ) const noexcept {
+    const express_tcp_t& HEAD( CALBK cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          item.path     = nullptr;
          item.method   = "HEAD";
          item.callback = cb;
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
     /*.........................................................................*/
 
-    const express_tcp_t& TRACE( string_t _path, CALBK cb ) const noexcept {
+    const express_tcp_t& TRACE( string_t _path, CALBK cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          item.method   = "TRACE";
          item.path     = _path;
          item.callback = cb;
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
-    const express_tcp_t& TRACE( CALBK cb ) const noexcept {
+    const express_tcp_t& TRACE( CALBK cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          item.path     = nullptr;
          item.method   = "TRACE";
          item.callback = cb;
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
     /*.........................................................................*/
 
-    const express_tcp_t& PATCH( string_t _path, CALBK cb ) const noexcept {
+    const express_tcp_t& PATCH( string_t _path, CALBK cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          item.method   = "PATCH";
          item.path     = _path;
          item.callback = cb;
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
-    const express_tcp_t& PATCH( CALBK cb ) const noexcept {
+    const express_tcp_t& PATCH( CALBK cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          item.path     = nullptr;
          item.method   = "PATCH";
          item.callback = cb;
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
     /*.........................................................................*/
 
-    const express_tcp_t& OPTIONS( string_t _path, CALBK cb ) const noexcept {
+    const express_tcp_t& OPTIONS( string_t _path, CALBK cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          item.method   = "OPTIONS";
          item.path     = _path;
          item.callback = cb;
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
-    const express_tcp_t& OPTIONS( CALBK cb ) const noexcept {
+    const express_tcp_t& OPTIONS( CALBK cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          item.method   = "OPTIONS";
          item.path     = nullptr;
          item.callback = cb;
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
     /*.........................................................................*/
 
-    const express_tcp_t& CONNECT( string_t _path, CALBK cb ) const noexcept {
+    const express_tcp_t& CONNECT( string_t _path, CALBK cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          item.method   = "CONNECT";
          item.path     = _path;
          item.callback = cb;
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
-    const express_tcp_t& CONNECT( CALBK cb ) const noexcept {
+    const express_tcp_t& CONNECT( CALBK cb ) const {
          express_item_t item; memset( &item, sizeof(item), 0 );
          item.method   = "CONNECT";
          item.path     = nullptr;
          item.callback = cb;
-         obj->list.push( item ); return (*this);
+         push( item ); return (*this);
     }
 
     /*.........................................................................*/
@@ -627,9 +2798,8 @@ public:
           auto self = type::bind( this );
 
           function_t<void,http_t> cb = [=]( http_t cli ){
-               express_http_t res( cli ); if( res.headers["params"] ){
-                   res.params = query::parse( res.headers["params"] ); 
-               }   self->run( nullptr, res );
+               ptr_t<_express_::pipeline_t> pipe = new _express_::pipeline_t( self->obj->depth );
+               self->accept( cli, pipe );
           };
 
           obj->fd=http::server( cb, obj->agent );
@@ -644,52 +2814,142 @@ namespace nodepp { namespace express { namespace http {
 
      template< class... T > express_tcp_t add( T... args ) { return express_tcp_t(args...); }
 
-     express_tcp_t file( string_t base ) { 
+     void precompress( string_t base ) { _express_::precompress( base ); }
+
+     void reload( string_t path=nullptr ) { _express_::reload( path ); }
+
+     /* includes without a directive are cached for `age` seconds ( 0 keeps
+        them uncached ) and served stale for `stale` more while refreshing */
+
+     void set_fragment_cache( ulong limit, ulong age=0, ulong stale=0 ) {
+          auto pool = _express_::fragments(); pool->limit = limit;
+          pool->age = age; pool->stale = stale; pool->clear();
+     }
+
+     /* requests through the shared upstream pool: keep-alive connections
+        per origin, one TLS context, `onEnd` gets 0 or a 4xx / 5xx status */
+
+     void fetch( fetch_t args, function_t<void,_express_::reply_t&> onHead, function_t<void,string_t> onData, function_t<void,uint> onEnd ) {
+          ptr_t<_express_::call_t> call = new _express_::call_t();
+          call->url = args.url; call->headers = args.headers; call->body = args.body;
+          if( !args.method.empty() ){ call->method = args.method; }
+          call->onHead = onHead; call->onData = onData; call->onEnd = onEnd;
+          _express_::fetch( call );
+     }
+
+     void set_upstream( ulong max_idle, ulong per_host=32, ulong timeout=30000, ulong deadline=10000 ) {
+          auto a = _express_::upstream<http_t>(), b = _express_::upstream<https_t>();
+          a->max_idle = b->max_idle = max_idle; a->per_host = b->per_host = per_host;
+          a->timeout  = b->timeout  = timeout;  a->deadline = b->deadline = deadline;
+     }
+
+     /* body parsers: each one only claims its own Content-Type, reads at
+        most `limit` bytes and answers 413 / 400 itself when it has to stop */
+
+     MIDDL json( ulong limit=CHUNK_MB(1) ) {
+          return [=]( express_http_t& cli, function_t<void> next ){
+               if( !regex::test( cli.headers["Content-Type"], "json", true ) ){ next(); return; }
+               ptr_t<_express_::collect_t> data = new _express_::collect_t( min( cli.get_unread(), limit ) ); auto self = cli;
+
+               cli.readBody( limit, [=]( string_t chunk ){ data->push( chunk ); return 0u; }, [=]( uint code ){
+                    auto text = data->get(); if( code == 0 && text.empty() ){ next(); return; } /* no body, nothing to parse */
+                    if( code == 0 ){ try { self.body().json = ::nodepp::json::parse( text ); } catch(...) { code = 400; }}
+                    if( code != 0 ){ self.status( code ).send( _express_::reason( code ) ); return; } next();
+               });
+          };
+     }
+
+     MIDDL urlencoded( ulong limit=CHUNK_KB(100) ) {
+          return [=]( express_http_t& cli, function_t<void> next ){
+               if( !regex::test( cli.headers["Content-Type"], "^application/x-www-form-urlencoded", true ) ){ next(); return; }
+               ptr_t<_express_::urlencoded_t> form = new _express_::urlencoded_t(); auto self = cli;
+
+               cli.readBody( limit, [=]( string_t chunk ){ form->push( chunk ); return 0u; }, [=]( uint code ){
+                    if( code != 0 ){ self.status( code ).send( _express_::reason( code ) ); return; }
+                    form->end(); self.body().form = form->form; next();
+               });
+          };
+     }
+
+     MIDDL multipart( ulong limit=CHUNK_MB(16) ) {
+          return [=]( express_http_t& cli, function_t<void> next ){
+               if( !regex::test( cli.headers["Content-Type"], "^multipart/form-data", true ) ){ next(); return; }
+               _express_::multipart( cli, limit, ptr_t<_express_::spool_t>(), next );
+          };
+     }
+
+     /* like multipart() but every file part is streamed to the stream
+        `open` returns for it; cli.body().files only carries metadata */
+
+     MIDDL uploadStream( function_t<file_t,_express_::part_t&> open, ulong limit=CHUNK_MB(1024) ) {
+          return [=]( express_http_t& cli, function_t<void> next ){
+               if( !regex::test( cli.headers["Content-Type"], "^multipart/form-data", true ) ){ next(); return; }
+               _express_::multipart( cli, limit, new _express_::spool_t( open ), next );
+          };
+     }
+
+     /* file parts land in `dir` as upload-* files, their path is kept in
+        the part metadata and the handler owns them once it runs */
+
+     MIDDL upload( string_t dir, ulong limit=CHUNK_MB(1024) ) { ptr_t<ulong> seq = new ulong(0);
+          return uploadStream([=]( _express_::part_t& part ){
+               part.path = path::join( dir, string::format( "upload-%lx-%lx-%lx", process::now(), (*seq)++,
+                           _express_::hash( part.filename.get(), part.filename.size() ) ) );
+               return file_t( part.path, "w" );
+          }, limit );
+     }
+
+     express_tcp_t file( string_t base, ulong limit=CHUNK_MB(32) ) { 
           
-          express_tcp_t app;
+          express_tcp_t app; ptr_t<_express_::assets_t> pool = new _express_::assets_t();
+          pool->cache = _express_::cache_t<_express_::asset_t>( 1024 ); 
+          pool->limit = limit; pool->max = CHUNK_KB(256);
 
           app.ALL([=]( express_http_t cli ){
 
                auto pth = regex::replace( cli.path, app.get_path(), "/" );
                     pth = regex::replace_all( pth, "\\.[.]+/", "" );
 
-               auto dir = pth.empty() ? path::join( base, "" ) :
-                                        path::join( base,pth ) ;
+               auto item = _express_::asset( pool, base, pth );
+               if ( item.null() ){ cli.status(404).send("Oops 404 Error"); return; }
+               auto dir  = item->dir; cli.status( item->status );
 
-               if ( dir.empty() ){ dir = path::join( base, "index.html" ); }
-               if ( dir[dir.last()] == '/' ){ dir += "index.html"; }
+               array_t<_express_::range_t> list; int range = 0; cli.header( "Accept-Ranges", "bytes" );
+               if( item->status==200 && !cli.headers["Range"].empty() && _express_::if_range( cli.headers["If-Range"], item ) )
+                 { range = _express_::ranges( cli.headers["Range"], item->size, list ); }
 
-               if( fs::exists_file(dir+".html") == true ){ dir += ".html"; }
-               if( fs::exists_file(dir) == false || dir == base ){
-               if( fs::exists_file( path::join( base, "404.html" ) )){
-                   dir = path::join( base, "404.html" );
-                   cli.status(404);
-               } else { 
-                   cli.status(404).send("Oops 404 Error"); 
-                   return; 
-               }}
+               if ( range == 0 ){
 
-               if ( cli.headers["Range"].empty() == true ){
+                    if( regex::test(item->type,"audio|video",true) ){ cli.send(); return; }
+                    if( regex::test(item->type,"html",true) ){ cli.render(dir); return; }
 
-                    if( regex::test(path::mimetype(dir),"audio|video",true) ){ cli.send(); return; }
-                    if( regex::test(path::mimetype(dir),"html",true) ){ cli.render(dir); } else { 
-                        cli.header( "Cache-Control", "public, max-age=604800" );
-			         cli.sendFile( dir );
-                    }
+                    cli.header( "Cache-Control", "public, max-age=604800" );
+                    cli.header( "Last-Modified", item->date ).header( "ETag", item->etag );
+
+                    if( item->status==200 && _express_::fresh( cli.headers["If-None-Match"], cli.headers["If-Modified-Since"], item ) )
+                      { cli.status(304).send(); cli.finish(); return; }
+
+                    if( !item->memory ){ cli.sendFile( dir ); return; }
+                    cli.header( "Content-Type", item->type ).header( "Vary", "Accept-Encoding" );
 
-               } else { auto str = fs::readable( dir );
+                      if( !item->br  .empty() && cli.accepts( "br"   ) ){ cli.header( "Content-Encoding", "br"   ).sendRaw( item->br   ); }
+                    elif( !item->gzip.empty() && cli.accepts( "gzip" ) ){ cli.header( "Content-Encoding", "gzip" ).sendRaw( item->gzip ); }
+                    else { cli.sendRaw( item->data ); }
 
-                    array_t<string_t> range = regex::match_all(cli.headers["Range"],"\\d+",true);
-                     ulong rang[3]; rang[0] = string::to_ulong( range[0] );
-                           rang[1] =min(rang[0]+CHUNK_MB(10),str.size()-1);
-                           rang[2] =min(rang[0]+CHUNK_MB(10),str.size()  );
+               } elif( range < 0 ){
+
+                    cli.header( "Content-Range", string::format( "bytes */%lu", item->size ) );
+                    cli.status(416).send( "" );
+
+               } else {
 
-                    cli.header( "Content-Range", string::format("bytes %lu-%lu/%lu",rang[0],rang[1],str.size()) );
-                    cli.header( "Content-Type",  path::mimetype(dir) ); cli.header( "Accept-Range", "bytes" ); 
                     cli.header( "Cache-Control", "public, max-age=604800" ); 
+                    cli.header( "Last-Modified", item->date ).header( "ETag", item->etag );
+
+                    if( list.size() > 1 ){ cli.status(206).sendRanges( dir, list, item->type ); return; }
 
-                    str.set_range( rang[0], rang[2] ); 
-                    cli.status(206).sendStream( str );
+                    cli.header( "Content-Range", string::format("bytes %lu-%lu/%lu",list[0].begin,list[0].end-1,item->size) );
+                    cli.header( "Content-Type",  item->type ); cli.status(206).sendRange( dir, list[0].begin, list[0].end );
 
                }
           });